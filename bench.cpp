@@ -0,0 +1,492 @@
+/**
+ * @file bench.cpp
+ * @brief Microbenchmarks for the burger shop's hot-path building blocks.
+ *
+ * Each benchmark runs in-process on synthetic input and prints its throughput.
+ * Pass benchmark names to run a subset; with no arguments everything runs.
+ *
+ * @author Michael Barry
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <poll.h>
+#include "dispatch_policy.h"
+#include "event_feed.h"
+#include "intake_queue.h"
+#include "kitchen_sim.h"
+#include "message_parser.h"
+#include "order_history.h"
+#include "scanner.h"
+
+using namespace std;
+
+/**
+ * @brief Builds a receive buffer of pipelined orders with mixed delimiters and some junk.
+ * @param padding Mean length of the delimiter runs between orders (0 = back to back).
+ */
+string makeOrderStream(size_t bytes, unsigned seed, size_t padding = 0) {
+    static const char* const pieces[] = {"Order", "Order\n", "Order\r\n", "Order ", "Order\n\n", "xOrder", "Ord3r\n"};
+    mt19937 rng(seed);
+    string stream;
+    stream.reserve(bytes + 16);
+    while (stream.size() < bytes) {
+        unsigned pick = rng() % 100;
+        stream += pieces[pick < 90 ? pick % 5 : 5 + pick % 2];
+        stream.append(padding ? rng() % (2 * padding) : 0, pick % 2 ? ' ' : '\n');
+    }
+    return stream;
+}
+
+/**
+ * @brief Times one scanner over the whole buffer, repeatedly.
+ */
+void benchScanner(const char* name, ScanFunction scanner, const string& stream, int rounds) {
+    vector<MessageType> out(stream.size());
+    size_t messages = 0;
+    auto start = chrono::steady_clock::now();
+    for (int round = 0; round < rounds; ++round) {
+        messages = scanner(stream.data(), stream.size(), out.data(), out.size()).messages;
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    double bytes = static_cast<double>(stream.size()) * rounds;
+    cout << "  " << setw(16) << left << name << right << setw(10) << fixed << setprecision(0) << bytes / seconds / 1e6
+         << " MB/s" << setw(10) << setprecision(1) << messages * rounds / seconds / 1e6 << " M msg/s"
+         << "  (" << messages << " messages)" << endl;
+}
+
+/**
+ * @brief Compares the batch scanners with each other and with the incremental parser.
+ */
+void scannerBenchmark() {
+    string stream = makeOrderStream(1 << 20, 42);
+    const int rounds = 50;
+    cout << "scanner: " << stream.size() << " byte receive buffer, best available is " << scannerName() << endl;
+
+    // The incremental parser fed in socket-sized reads is the pre-SIMD baseline
+    auto start = chrono::steady_clock::now();
+    size_t messages = 0;
+    for (int round = 0; round < rounds; ++round) {
+        MessageParser parser;
+        MessageType message;
+        messages = 0;
+        for (size_t offset = 0; offset < stream.size();) {
+            size_t space;
+            char* into = parser.writeSpan(space);
+            size_t chunk = min(space, stream.size() - offset);
+            memcpy(into, stream.data() + offset, chunk);
+            parser.commit(chunk);
+            offset += chunk;
+            while (parser.next(message)) messages++;
+        }
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout << "  " << setw(16) << left << "parser.next" << right << setw(10) << fixed << setprecision(0)
+         << stream.size() * rounds / seconds / 1e6 << " MB/s" << setw(10) << setprecision(1)
+         << messages * rounds / seconds / 1e6 << " M msg/s" << "  (" << messages << " messages, includes copy)" << endl;
+
+    string padded = makeOrderStream(1 << 20, 42, 64);
+    for (const string* input : {&stream, &padded}) {
+        if (input == &padded) cout << "scanner: orders separated by ~64 delimiter bytes" << endl;
+        benchScanner("scalar", scanMessagesScalar, *input, rounds);
+#ifdef BURGER_SCANNER_X86
+        if (__builtin_cpu_supports("sse2")) benchScanner("sse2", scanMessagesSse2, *input, rounds);
+        if (__builtin_cpu_supports("avx2")) benchScanner("avx2", scanMessagesAvx2, *input, rounds);
+#endif
+    }
+}
+
+/**
+ * @brief Fans one publisher's order events out to growing numbers of kitchen displays.
+ *
+ * Reports the publisher's cost per event, which should not grow with the number of
+ * subscribers, and the total rate at which events reach subscribers.
+ */
+void feedBenchmark() {
+    const uint64_t events = 200000;
+    cout << "feed: " << events << " events per run" << endl;
+    for (int subscribers : {0, 1, 16, 256}) {
+        EventFeed feed(events); // Large enough that no subscriber is dropped for lagging
+        atomic<uint64_t> delivered{0};
+        atomic<int> lagged{0};
+        vector<thread> displays;
+        for (int i = 0; i < subscribers; ++i) {
+            uint64_t cursor = feed.subscribe();
+            displays.emplace_back([&feed, &delivered, &lagged, cursor, events]() mutable {
+                vector<EventFeed::Event> batch;
+                uint64_t received = 0;
+                while (cursor < events) {
+                    feed.wait(cursor, 100);
+                    if (!feed.read(cursor, batch, 256)) {
+                        lagged++;
+                        break;
+                    }
+                    received += batch.size();
+                    if (!batch.empty() && batch.size() < 256) this_thread::sleep_for(chrono::milliseconds(kFeedLingerMs));
+                }
+                delivered += received;
+                feed.unsubscribe();
+            });
+        }
+
+        auto start = chrono::steady_clock::now();
+        for (uint64_t i = 0; i < events; ++i) feed.publish("ready burger " + to_string(i) + " Chef 1");
+        double publishSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        for (thread& display : displays) display.join();
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        cout << "  " << setw(5) << subscribers << " subscribers" << setw(10) << fixed << setprecision(0)
+             << publishSeconds * 1e9 / events << " ns/publish" << setw(10) << setprecision(1)
+             << delivered / seconds / 1e6 << " M deliveries/s";
+        if (lagged > 0) cout << "  (" << lagged << " lagged)";
+        cout << endl;
+    }
+}
+
+/**
+ * @brief Replays rush-and-lull demand through the kitchen simulator with fixed and forecast stock targets.
+ *
+ * Burgers expire after 30 s, so a large fixed target wastes food in every lull
+ * and a small one makes orders wait in every rush; a forecast target should
+ * beat both. Results are averaged over several seeds.
+ */
+void forecastBenchmark() {
+    struct Policy {
+        const char* name;
+        int stockTarget;
+        double forecastInterval;
+    };
+    const Policy policies[] = {
+        {"cook ahead", 0, 0}, {"fixed 3", 3, 0}, {"fixed 5", 5, 0}, {"fixed 8", 8, 0},
+        {"fixed 12", 12, 0}, {"forecast 5 s", 0, 5}, {"forecast 10 s", 0, 10},
+    };
+    const int seeds = 5;
+    cout << "forecast: 3000 burgers, 4 chefs, 0.7 orders/s swinging over 600 s, 30 s freshness, " << seeds << " seeds" << endl;
+    cout << "  " << setw(14) << left << "policy" << right << setw(10) << "mean s" << setw(10) << "p99 s" << setw(10) << "waste %" << endl;
+    for (const Policy& policy : policies) {
+        double meanWait = 0, p99Wait = 0, waste = 0;
+        for (int seed = 1; seed <= seeds; ++seed) {
+            SimConfig config;
+            config.maxBurgers = 3000;
+            config.numChefs = 4;
+            config.arrivalRate = 0.7;
+            config.rushPeriod = 600;
+            config.freshness = 30;
+            config.stockTarget = policy.stockTarget;
+            config.forecastInterval = policy.forecastInterval;
+            config.seed = seed;
+            SimResult result = KitchenSimulation(config).run();
+            meanWait += result.meanWait / seeds;
+            p99Wait += result.p99Wait / seeds;
+            waste += 100.0 * result.burgersWasted / (config.maxBurgers + result.burgersWasted) / seeds;
+        }
+        cout << "  " << setw(14) << left << policy.name << right << fixed << setprecision(2) << setw(10) << meanWait
+             << setw(10) << p99Wait << setw(10) << waste << endl;
+    }
+}
+
+/**
+ * @brief A waiting order in the dispatch benchmark.
+ */
+struct BenchOrder {
+    int client; // Client index
+    long placed; // Tick it arrived
+    int priority; // 0 for single-order clients, 1 for bulk clients
+};
+
+constexpr int kBulkClients = 8; // Clients that keep kBulkPipeline orders outstanding
+constexpr int kBulkPipeline = 16;
+constexpr int kSingleClients = 56; // Clients that order one burger, then think for kSingleThinkTicks
+constexpr long kSingleThinkTicks = 100;
+
+/**
+ * @brief Mean and 99th percentile of a set of waits, in ticks.
+ */
+void printWaits(vector<long>& waits) {
+    double mean = 0;
+    for (long wait : waits) mean += static_cast<double>(wait) / waits.size();
+    size_t p99 = waits.size() * 99 / 100;
+    nth_element(waits.begin(), waits.begin() + p99, waits.end());
+    cout << setw(9) << mean << setw(7) << waits[p99];
+}
+
+/**
+ * @brief Runs one policy through a closed-loop kitchen that serves one burger per tick.
+ *
+ * The loop is instantiated for each policy, as in the server, so the time per
+ * order is the policy's own push and pop plus the same bookkeeping for all.
+ */
+template <typename Queue>
+void benchDispatch(Queue& queue, long ticks) {
+    vector<long> singleWaits, bulkWaits;
+    singleWaits.reserve(ticks);
+    bulkWaits.reserve(ticks);
+    deque<pair<long, int>> thinking; // Single clients by the tick they order again
+    for (int client = 0; client < kBulkClients; ++client) {
+        for (int i = 0; i < kBulkPipeline; ++i) queue.push({client, 0, 1});
+    }
+    for (int client = kBulkClients; client < kBulkClients + kSingleClients; ++client) {
+        thinking.push_back({client - kBulkClients, client}); // Staggered first orders
+    }
+
+    auto start = chrono::steady_clock::now();
+    for (long tick = 0; tick < ticks; ++tick) {
+        while (!thinking.empty() && thinking.front().first <= tick) {
+            queue.push({thinking.front().second, tick, 0});
+            thinking.pop_front();
+        }
+        BenchOrder order = queue.pop();
+        if (order.client < kBulkClients) {
+            bulkWaits.push_back(tick - order.placed);
+            queue.push({order.client, tick, 1}); // Bulk clients refill their pipeline at once
+        } else {
+            singleWaits.push_back(tick - order.placed);
+            thinking.push_back({tick + kSingleThinkTicks, order.client});
+        }
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    cout << "  " << setw(10) << left << Queue::kName << right << fixed << setprecision(1) << setw(10) << seconds * 1e9 / ticks;
+    printWaits(singleWaits);
+    printWaits(bulkWaits);
+    cout << setw(11) << bulkWaits.size() * 100 / ticks << "%" << endl;
+}
+
+/**
+ * @brief Compares the dispatch policies' cost per order and their effect on who waits.
+ *
+ * Bulk clients keep many orders outstanding over the network, and single-order
+ * clients are co-located; waits are in burgers served.
+ */
+void dispatchBenchmark() {
+    const long ticks = 2000000;
+    cout << "dispatch: " << kBulkClients << " bulk clients x " << kBulkPipeline << " orders, " << kSingleClients
+         << " single-order clients thinking " << kSingleThinkTicks << " burgers" << endl;
+    cout << "  " << setw(10) << left << "policy" << right << setw(10) << "ns/order" << setw(9) << "single" << setw(7) << "p99"
+         << setw(9) << "bulk" << setw(7) << "p99" << setw(12) << "bulk share" << endl;
+    DispatchQueue<BenchOrder> queues[] = {FifoDispatch<BenchOrder>(), FairDispatch<BenchOrder>(), PriorityDispatch<BenchOrder>(),
+                                          ShortestJobDispatch<BenchOrder>()};
+    for (auto& queue : queues) {
+        visit([ticks](auto& policy) { benchDispatch(policy, ticks); }, queue);
+    }
+}
+
+/**
+ * @brief An order as an I/O thread hands it to the dispatcher, the size of the server's UDP orders.
+ */
+struct IntakeOrder {
+    uint64_t words[4];
+};
+
+constexpr size_t kIntakeDrainBatch = 64; // Orders the consumer takes per drain, as the UDP dispatcher does
+
+/**
+ * @brief Hands orders from a producer thread to a consumer thread through an IntakeQueue.
+ *
+ * @return Seconds until the consumer has received every order.
+ */
+double benchIntakeQueue(long orders, size_t batch) {
+    IntakeQueue<IntakeOrder> queue;
+    thread consumer([&queue, orders]() {
+        IntakeOrder drained[kIntakeDrainBatch];
+        for (long received = 0; received < orders;) {
+            size_t count = queue.drain(drained, kIntakeDrainBatch);
+            received += count;
+            if (count > 0) continue;
+            pollfd fd{queue.wakeFd(), POLLIN, 0};
+            if (queue.prepareToSleep()) poll(&fd, 1, 100);
+            queue.wokeUp();
+        }
+    });
+    vector<IntakeOrder> pending(batch);
+    auto start = chrono::steady_clock::now();
+    for (long sent = 0; sent < orders;) {
+        size_t count = min<long>(batch, orders - sent);
+        for (size_t pushed = 0; pushed < count;) {
+            size_t accepted = queue.push(pending.data() + pushed, count - pushed);
+            if (accepted == 0) this_thread::yield(); // Full: let the consumer catch up
+            pushed += accepted;
+        }
+        sent += count;
+    }
+    consumer.join();
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * @brief The same hand-off through a mutex-guarded deque and a condition variable, for comparison.
+ */
+double benchMutexQueue(long orders, size_t batch) {
+    mutex queueMutex;
+    condition_variable orderReady;
+    deque<IntakeOrder> queue;
+    bool consumerWaiting = false;
+    thread consumer([&, orders]() {
+        IntakeOrder drained[kIntakeDrainBatch];
+        for (long received = 0; received < orders;) {
+            unique_lock<mutex> lock(queueMutex);
+            consumerWaiting = queue.empty();
+            orderReady.wait(lock, [&queue]() { return !queue.empty(); });
+            consumerWaiting = false;
+            size_t count = min(queue.size(), kIntakeDrainBatch);
+            copy(queue.begin(), queue.begin() + count, drained);
+            queue.erase(queue.begin(), queue.begin() + count);
+            received += count;
+        }
+    });
+    vector<IntakeOrder> pending(batch);
+    auto start = chrono::steady_clock::now();
+    for (long sent = 0; sent < orders;) {
+        size_t count = min<long>(batch, orders - sent);
+        bool wake;
+        {
+            lock_guard<mutex> lock(queueMutex);
+            queue.insert(queue.end(), pending.begin(), pending.begin() + count);
+            wake = consumerWaiting;
+        }
+        if (wake) orderReady.notify_one();
+        sent += count;
+    }
+    consumer.join();
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * @brief Measures the cost per order of handing decoded orders from an I/O thread to the dispatcher.
+ */
+void intakeBenchmark() {
+    const long orders = 4000000;
+    cout << "intake: " << orders << " orders from one producer thread to one consumer thread" << endl;
+    for (size_t batch : {1, 16, 64}) {
+        double queueSeconds = benchIntakeQueue(orders, batch);
+        double mutexSeconds = benchMutexQueue(orders, batch);
+        cout << "  batches of " << setw(2) << batch << ": intake queue " << fixed << setprecision(1) << setw(6)
+             << queueSeconds * 1e9 / orders << " ns/order, mutex queue " << setw(6) << mutexSeconds * 1e9 / orders << " ns/order" << endl;
+    }
+}
+
+/**
+ * @brief Measures recording into and querying the order history, and what it costs in memory.
+ *
+ * Clients order at skewed rates, a few milliseconds apart overall, as a busy shop sees them.
+ */
+void historyBenchmark() {
+    const long orders = 4000000;
+    const int clients = 20000;
+    cout << "history: " << orders << " orders from " << clients << " clients" << endl;
+    OrderHistory history;
+    uint8_t items[] = {history.itemId("burger"), history.itemId("fries"), history.itemId("shake")};
+    mt19937 rng(7);
+    exponential_distribution<double> gap(1.0 / 500); // Mean microseconds between orders shop-wide
+    vector<uint64_t> client(orders);
+    vector<int64_t> micros(orders);
+    double now = 0;
+    for (long i = 0; i < orders; ++i) {
+        double skew = generate_canonical<double, 32>(rng);
+        client[i] = static_cast<uint64_t>(clients * skew * skew * skew); // Low ids order far more often
+        now += gap(rng);
+        micros[i] = static_cast<int64_t>(now);
+    }
+
+    auto orderAt = [&](long i) {
+        return HistoryRecord{client[i], micros[i], items[i % 10 == 0 ? 1 + i % 2 : 0], i % 50 == 0 ? OrderOutcome::Refused : OrderOutcome::Served};
+    };
+    auto start = chrono::steady_clock::now();
+    for (long i = 0; i < orders; ++i) {
+        HistoryRecord order = orderAt(i);
+        history.record(order.client, order.micros, order.item, order.outcome);
+    }
+    double recordSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    OrderHistory::Usage usage = history.usage();
+    cout << "  record:     " << fixed << setprecision(1) << setw(8) << recordSeconds * 1e9 / orders << " ns/order, "
+         << setprecision(2) << double(usage.bytes) / usage.orders << " bytes/order, " << setprecision(1) << usage.bytes / 1048576.0
+         << " MB for the " << usage.orders << " orders kept (a " << sizeof(uint64_t) + sizeof(int64_t) << "-byte row per order: "
+         << usage.orders * 16 / 1048576.0 << " MB)" << endl;
+
+    // The server hands over each client handler's orders 64 at a time
+    vector<vector<HistoryRecord>> batches;
+    unordered_map<uint64_t, vector<HistoryRecord>> collecting;
+    for (long i = 0; i < orders; ++i) {
+        vector<HistoryRecord>& batch = collecting[client[i]];
+        batch.push_back(orderAt(i));
+        if (batch.size() == 64) {
+            batches.push_back(move(batch));
+            batch.clear();
+        }
+    }
+    for (auto& entry : collecting) batches.push_back(move(entry.second));
+    OrderHistory batched;
+    for (const char* name : {"burger", "fries", "shake"}) batched.itemId(name);
+    start = chrono::steady_clock::now();
+    for (const vector<HistoryRecord>& batch : batches) batched.record(batch.data(), batch.size());
+    double batchedSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout << "  batched:    " << setw(8) << batchedSeconds * 1e9 / orders << " ns/order, a client's orders 64 at a time" << endl;
+
+    const int queries = 2000;
+    int64_t span = micros.back() / 100; // A hundredth of the run
+    size_t found = 0;
+    start = chrono::steady_clock::now();
+    for (int i = 0; i < queries; ++i) {
+        int64_t from = static_cast<int64_t>(rng() % static_cast<uint64_t>(micros.back() - span));
+        found += history.ordersOf(client[rng() % orders], from, from + span, [](const HistoryEntry&) {});
+    }
+    double rangeSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout << "  range:      " << setw(8) << rangeSeconds * 1e6 / queries << " us/query, " << double(found) / queries << " orders/query" << endl;
+
+    start = chrono::steady_clock::now();
+    vector<ClientTotals> top = history.topClients(10);
+    double topSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout << "  top 10:     " << setw(8) << topSeconds * 1e3 << " ms, busiest client " << top.front().client << " with "
+         << top.front().orders << " orders" << endl;
+}
+
+/**
+ * @brief The main function for the benchmarks.
+ *
+ * @param argc The number of command line arguments.
+ * @param argv Names of the benchmarks to run (default: all).
+ * @return int Returns 0 on successful execution, 1 otherwise.
+ */
+int main(int argc, char* argv[]) {
+    struct Benchmark {
+        const char* name;
+        void (*run)();
+    };
+    const Benchmark benchmarks[] = {
+        {"scanner", scannerBenchmark},
+        {"feed", feedBenchmark},
+        {"forecast", forecastBenchmark},
+        {"dispatch", dispatchBenchmark},
+        {"intake", intakeBenchmark},
+        {"history", historyBenchmark},
+    };
+
+    for (int i = 1; i < argc; ++i) {
+        bool known = false;
+        for (const Benchmark& benchmark : benchmarks) known = known || strcmp(argv[i], benchmark.name) == 0;
+        if (!known) {
+            cout << "Usage: " << argv[0] << " [Benchmark...]" << endl << "Benchmarks:";
+            for (const Benchmark& benchmark : benchmarks) cout << " " << benchmark.name;
+            cout << endl;
+            return 1;
+        }
+    }
+    for (const Benchmark& benchmark : benchmarks) {
+        bool selected = argc == 1;
+        for (int i = 1; i < argc; ++i) selected = selected || strcmp(argv[i], benchmark.name) == 0;
+        if (selected) benchmark.run();
+    }
+    return 0;
+}
@@ -0,0 +1,165 @@
+/**
+ * @file chef_profile.h
+ * @brief Chef skill profiles and expected-completion-time dispatch.
+ *
+ * Each chef has a preparation time distribution, a set of items they can make
+ * and a shift. Work goes to the eligible chef expected to finish it first, which
+ * may mean leaving a slow chef idle when a fast one is about to free up. Shared
+ * by the live server and the kitchen simulator.
+ *
+ * Profile files hold one chef per line:
+ *
+ *     <Name> <MeanSeconds> <StddevSeconds> <Items|*> <ShiftStart-ShiftEnd|*> [Batch]
+ *
+ * Items are comma separated; shift times are seconds after opening. Batch is how
+ * many burgers the chef grills at once in one preparation time (default 1).
+ * Blank lines and lines starting with '#' are ignored. Preparation times of
+ * profiled chefs are normally distributed; the default chefs keep the original
+ * kitchen's 2 or 4 seconds.
+ *
+ * @author Michael Barry
+ */
+
+#ifndef BURGER_CHEF_PROFILE_H
+#define BURGER_CHEF_PROFILE_H
+
+#include <algorithm>
+#include <fstream>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/**
+ * @brief The skills and schedule of one chef.
+ */
+struct ChefProfile {
+    std::string name; // Shown in logs and metrics
+    double meanPrep = 3.0; // Mean preparation time in seconds
+    double stddevPrep = 1.0; // Standard deviation of preparation time
+    std::vector<std::string> items; // Items this chef can make (empty = everything)
+    double shiftStart = 0; // Seconds after opening the chef starts
+    double shiftEnd = std::numeric_limits<double>::infinity(); // Seconds after opening the chef leaves
+    int batchSize = 1; // Burgers cooked together in one preparation time (a grill load)
+    bool evenOdds = false; // Prep takes mean - stddev or mean + stddev, each half the time, instead of a normal draw
+
+    bool canMake(const std::string& item) const {
+        return items.empty() || std::find(items.begin(), items.end(), item) != items.end();
+    }
+
+    bool onShift(double now) const {
+        return now >= shiftStart && now < shiftEnd;
+    }
+
+    /**
+     * @brief Draws a preparation time, never less than a tenth of the mean.
+     */
+    template <typename Rng>
+    double samplePrep(Rng& rng) const {
+        if (stddevPrep <= 0) return meanPrep;
+        if (evenOdds) {
+            double prep = std::bernoulli_distribution()(rng) ? meanPrep + stddevPrep : meanPrep - stddevPrep;
+            return std::max(meanPrep * 0.1, prep);
+        }
+        return std::max(meanPrep * 0.1, std::normal_distribution<double>(meanPrep, stddevPrep)(rng));
+    }
+};
+
+/**
+ * @brief Identical profiles matching the original kitchen: 2 or 4 seconds with even odds (mean 3, stddev 1).
+ */
+inline std::vector<ChefProfile> defaultChefProfiles(int numChefs) {
+    std::vector<ChefProfile> profiles(numChefs);
+    for (int i = 0; i < numChefs; ++i) {
+        profiles[i].name = "Chef " + std::to_string(i + 1);
+        profiles[i].evenOdds = true;
+    }
+    return profiles;
+}
+
+/**
+ * @brief Reads chef profiles from a file.
+ * @param error Set to a description of the first problem found.
+ * @return The profiles, or an empty vector on error.
+ */
+inline std::vector<ChefProfile> loadChefProfiles(const std::string& path, std::string& error) {
+    std::ifstream file(path);
+    if (!file) {
+        error = "cannot open " + path;
+        return {};
+    }
+
+    std::vector<ChefProfile> profiles;
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line)) {
+        lineNumber++;
+        std::istringstream fields(line);
+        ChefProfile profile;
+        std::string items;
+        std::string shift;
+        if (!(fields >> profile.name) || profile.name[0] == '#') continue;
+        if (!(fields >> profile.meanPrep >> profile.stddevPrep >> items >> shift) || profile.meanPrep <= 0) {
+            error = path + ":" + std::to_string(lineNumber) + ": expected <Name> <Mean> <Stddev> <Items> <Shift> [Batch]";
+            return {};
+        }
+        if (!(fields >> profile.batchSize)) {
+            profile.batchSize = 1;
+        } else if (profile.batchSize < 1) {
+            error = path + ":" + std::to_string(lineNumber) + ": batch must be at least 1";
+            return {};
+        }
+        if (items != "*") {
+            std::istringstream itemList(items);
+            for (std::string item; std::getline(itemList, item, ',');) {
+                if (!item.empty()) profile.items.push_back(item);
+            }
+        }
+        if (shift != "*") {
+            char dash = 0;
+            std::istringstream shiftRange(shift);
+            if (!(shiftRange >> profile.shiftStart >> dash >> profile.shiftEnd) || dash != '-' ||
+                profile.shiftEnd <= profile.shiftStart) {
+                error = path + ":" + std::to_string(lineNumber) + ": shift must be <Start>-<End>";
+                return {};
+            }
+        }
+        profiles.push_back(profile);
+    }
+    if (profiles.empty()) error = path + ": no chefs defined";
+    return profiles;
+}
+
+/**
+ * @brief Picks the chef expected to complete the next item first.
+ *
+ * A chef's expected completion time is when they become free (or now, or the
+ * start of their shift) plus their mean preparation time. Chefs who cannot make
+ * the item or whose shift ends before they could start are skipped.
+ *
+ * @param profiles Chef profiles.
+ * @param freeAt When each chef finishes their current work (<= now if idle).
+ * @param now Current time in seconds after opening.
+ * @param item The item to make.
+ * @return Index of the chosen chef, or -1 if no chef can make the item any more.
+ */
+inline int chooseChef(const std::vector<ChefProfile>& profiles, const std::vector<double>& freeAt, double now,
+                      const std::string& item) {
+    int best = -1;
+    double bestCompletion = std::numeric_limits<double>::infinity();
+    for (size_t i = 0; i < profiles.size(); ++i) {
+        const ChefProfile& profile = profiles[i];
+        if (!profile.canMake(item)) continue;
+        double start = std::max({now, freeAt[i], profile.shiftStart});
+        if (start >= profile.shiftEnd) continue;
+        double completion = start + profile.meanPrep;
+        if (completion < bestCompletion) {
+            bestCompletion = completion;
+            best = static_cast<int>(i);
+        }
+    }
+    return best;
+}
+
+#endif // BURGER_CHEF_PROFILE_H
@@ -2,7 +2,8 @@
  * @file client.cpp
  * @brief Client program for ordering and consuming burgers from a server.
  * 
- * This program connects to a server using TCP/IP and sends orders for burgers.
+ * This program connects to a server using TCP/IP (or any transport from transport.h)
+ * and sends orders for burgers.
  * It waits for the server to respond with the status of the order and simulates
  * eating the burgers that are served.
  * 
@@ -12,11 +13,182 @@
 #include <iostream>
 #include <cstring>
 #include <unistd.h>
+#include <string>
 #include <sys/socket.h>
 #include <arpa/inet.h>
 #include <chrono>
 #include <thread>
 #include <cstdlib>
+#include <memory>
+#include <vector>
+#include <poll.h>
+#include <csignal>
+#include "transport.h"
+#include "message_parser.h"
+#include "tls.h"
+
+/**
+ * @brief Places fire-and-forget orders over UDP.
+ *
+ * Sends all orders as "Order <ClientId> <OrderId>" datagrams in sendmmsg batches and
+ * then collects the batched acknowledgements with recvmmsg until every order is
+ * answered, the shop runs out, or the server stays silent for five seconds.
+ *
+ * @param serverIP IPv4 address of the server.
+ * @param port UDP port of the server.
+ * @param maxOrders Number of orders to place.
+ * @return 0 if every order was answered, 1 otherwise.
+ */
+int udpOrders(const std::string& serverIP, int port, int maxOrders) {
+    constexpr int kBatch = 64;
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sock < 0) {
+        perror("Socket creation failed");
+        return 1;
+    }
+    sockaddr_in serv_addr{};
+    serv_addr.sin_family = AF_INET;
+    serv_addr.sin_port = htons(port);
+    if (inet_pton(AF_INET, serverIP.c_str(), &serv_addr.sin_addr) <= 0 ||
+        connect(sock, (struct sockaddr *)&serv_addr, sizeof(serv_addr)) < 0) {
+        std::cout << "\nInvalid address/ Address not supported \n";
+        close(sock);
+        return 1;
+    }
+
+    unsigned long clientId = static_cast<unsigned long>(getpid());
+    char buffers[kBatch][128];
+    iovec iov[kBatch];
+    mmsghdr msgs[kBatch];
+
+    // Send all orders in batches
+    for (int first = 0; first < maxOrders; first += kBatch) {
+        int count = std::min(kBatch, maxOrders - first);
+        for (int i = 0; i < count; ++i) {
+            int len = snprintf(buffers[i], sizeof(buffers[i]), "%s %lu %d", Message<MessageType::Order>::text, clientId, first + i + 1);
+            iov[i] = {buffers[i], static_cast<size_t>(len)};
+            msgs[i] = {};
+            msgs[i].msg_hdr.msg_iov = &iov[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+        for (int sent = 0; sent < count;) {
+            int batch = sendmmsg(sock, msgs + sent, count - sent, 0);
+            if (batch <= 0) {
+                std::cerr << "Failed to send orders. Exiting." << std::endl;
+                close(sock);
+                return 1;
+            }
+            sent += batch;
+        }
+    }
+    std::cout << "Ordered " << maxOrders << " burgers over UDP." << std::endl;
+
+    // Collect acknowledgements in batches
+    std::vector<bool> answered(maxOrders + 1, false);
+    int served = 0;
+    int answeredCount = 0;
+    while (answeredCount < maxOrders) {
+        pollfd fd{sock, POLLIN, 0};
+        if (poll(&fd, 1, 5000) <= 0) break;
+        for (int i = 0; i < kBatch; ++i) {
+            iov[i] = {buffers[i], sizeof(buffers[i]) - 1};
+            msgs[i] = {};
+            msgs[i].msg_hdr.msg_iov = &iov[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+        int received = recvmmsg(sock, msgs, kBatch, MSG_DONTWAIT, nullptr);
+        for (int i = 0; i < received; ++i) {
+            buffers[i][msgs[i].msg_len] = '\0';
+            unsigned long ackClient = 0;
+            int orderId = 0;
+            bool isServed = Message<MessageType::BurgerServed>::prefixOf(buffers[i], msgs[i].msg_len);
+            if (!isServed && !Message<MessageType::NoMoreBurgers>::prefixOf(buffers[i], msgs[i].msg_len)) continue;
+            size_t status = isServed ? Message<MessageType::BurgerServed>::length : Message<MessageType::NoMoreBurgers>::length;
+            if (sscanf(buffers[i] + status, " %lu %d", &ackClient, &orderId) != 2) continue;
+            if (ackClient != clientId || orderId < 1 || orderId > maxOrders || answered[orderId]) continue;
+            answered[orderId] = true;
+            answeredCount++;
+            if (isServed) served++;
+        }
+    }
+
+    std::cout << "Server served " << served << " of " << maxOrders << " burgers (" << maxOrders - answeredCount << " unanswered)." << std::endl;
+    close(sock);
+    return answeredCount == maxOrders ? 0 : 1;
+}
+
+#ifdef BURGER_TLS
+/**
+ * @brief Measures TLS connection setup, with and without session resumption.
+ *
+ * Opens count connections that each negotiate a new session, then count that
+ * resume the ticket from the first one, and reports handshakes per second for
+ * both. No orders are placed.
+ *
+ * @param context Client TLS context.
+ * @param endpoint "<ip>:<port>" of the server's TLS listener.
+ * @param count Connections per phase.
+ * @return 0 if every handshake succeeded, 1 otherwise.
+ */
+int tlsHandshakeBench(const std::shared_ptr<TlsContext>& context, const std::string& endpoint, int count) {
+    TlsTransport transport(context);
+    for (int phase = 0; phase < 2; ++phase) {
+        bool resume = phase == 1;
+        if (resume) {
+            // Pick up the ticket, which TLS 1.3 servers send just after the handshake
+            context->dropSession();
+            std::unique_ptr<Connection> connection = transport.connect(endpoint);
+            char buffer[64];
+            if (connection) connection->recv(buffer, sizeof(buffer), 100);
+        }
+        int resumed = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < count; ++i) {
+            if (!resume) context->dropSession();
+            std::unique_ptr<Connection> connection = transport.connect(endpoint);
+            if (!connection) {
+                std::cout << "TLS handshake failed: " << lastTlsError() << std::endl;
+                return 1;
+            }
+            if (static_cast<TlsConnection&>(*connection).resumed()) resumed++;
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << (resume ? "Resumed" : "Full") << " handshakes: " << count << " in " << seconds << " s ("
+                  << count / seconds << "/s, " << seconds * 1000 / count << " ms each, " << resumed << " resumed)." << std::endl;
+    }
+    return 0;
+}
+#endif
+
+/**
+ * @brief Acts as a kitchen display: prints the server's order status events as they arrive.
+ *
+ * @param connection Connection to the server.
+ * @return 0 once the shop closes, 1 if the connection was lost first.
+ */
+int followDisplayFeed(Connection& connection) {
+    if (!Message<MessageType::KitchenDisplay>::send(connection)) {
+        std::cout << "Failed to subscribe to the order feed." << std::endl;
+        return 1;
+    }
+    std::string received;
+    char buffer[4096];
+    while (true) {
+        int bytesReceived = connection.recv(buffer, sizeof(buffer));
+        if (bytesReceived <= 0) {
+            std::cout << "Disconnected from the order feed." << std::endl;
+            return 1;
+        }
+        received.append(buffer, bytesReceived);
+        size_t newline;
+        while ((newline = received.find('\n')) != std::string::npos) {
+            std::string line = received.substr(0, newline);
+            received.erase(0, newline + 1);
+            std::cout << line << std::endl;
+            if (Message<MessageType::NoMoreBurgers>::matches(line)) return 0;
+        }
+    }
+}
 
 /**
  * @brief Connects to a server and orders burgers.
@@ -31,66 +203,127 @@
  */
 int main(int argc, char* argv[]) {
     // Default server IP, port, and maximum orders
-    const char* serverIP = "127.0.0.1";
+    std::string serverIP = "127.0.0.1";
     int port = 54321;
     int maxOrders = 10;
 
-    // Parse command line arguments if provided
-    if (argc == 4) {
-        serverIP = argv[1];
-        port = std::stoi(argv[2]);
-        maxOrders = std::stoi(argv[3]);
-    } else if (argc != 1) {
+    std::string tlsCaPath; // Trusted certificates for tls: servers (empty = system store)
+    std::string tlsSessionPath; // Where the TLS session is kept between runs
+    int handshakes = 0; // Connections to open for the TLS handshake benchmark
+    bool display = false; // Follow the order status feed instead of ordering
+
+    // Parse command line arguments: three optional positionals followed by options
+    std::vector<std::string> positional;
+    bool usageError = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--tls-ca" && i + 1 < argc) {
+            tlsCaPath = argv[++i];
+        } else if (arg == "--tls-session" && i + 1 < argc) {
+            tlsSessionPath = argv[++i];
+        } else if (arg == "--handshakes" && i + 1 < argc) {
+            handshakes = atoi(argv[++i]);
+        } else if (arg == "--display") {
+            display = true;
+        } else if (arg.compare(0, 2, "--") == 0) {
+            usageError = true;
+        } else {
+            positional.push_back(arg);
+        }
+    }
+    if (usageError || (!positional.empty() && positional.size() != 3) ||
+        (handshakes > 0 && (positional.empty() || positional[0].compare(0, 4, "tls:") != 0))) {
         // Print usage if incorrect number of arguments provided
-        std::cout << "Usage: " << argv[0] << " <ServerIP> <Port> <MaxOrders>" << std::endl;
+        std::cout << "Usage: " << argv[0] << " <ServerIP> <Port> <MaxOrders>"
+                  << " [--tls-ca <PemFile>] [--tls-session <File>] [--handshakes <Count>] [--display]" << std::endl;
         return 1;
     }
+    if (positional.size() == 3) {
+        serverIP = positional[0];
+        port = std::stoi(positional[1]);
+        maxOrders = std::stoi(positional[2]);
+    }
 
     // Print connection details
     std::cout << "Connecting to server " << serverIP << " on port " << port << " with a maximum of " << maxOrders << " orders." << std::endl;
 
-    // Create socket
-    int sock = socket(AF_INET, SOCK_STREAM, 0);
-    if (sock < 0) {
-        perror("Socket creation failed");
-        return 1;
+    if (serverIP.compare(0, 4, "udp:") == 0) {
+        return udpOrders(serverIP.substr(4), port, maxOrders);
     }
 
-    // Initialize server address
-    sockaddr_in serv_addr;
-    serv_addr.sin_family = AF_INET;
-    serv_addr.sin_port = htons(port);
-
-    // Convert IP address to binary form
-    if (inet_pton(AF_INET, serverIP, &serv_addr.sin_addr) <= 0) {
-        std::cout << "\nInvalid address/ Address not supported \n";
+    // Pick the transport from the address scheme; plain addresses use TCP
+    std::string endpoint = serverIP;
+    std::unique_ptr<Transport> transport;
+    bool tls = endpoint.compare(0, 4, "tls:") == 0;
+#ifdef BURGER_TLS
+    std::shared_ptr<TlsContext> tlsContext;
+#endif
+    if (tls) {
+#ifdef BURGER_TLS
+        std::string error;
+        tlsContext = TlsContext::client(tlsCaPath, tlsSessionPath, error);
+        if (!tlsContext) {
+            std::cout << "TLS setup failed: " << error << std::endl;
+            return 1;
+        }
+        signal(SIGPIPE, SIG_IGN); // OpenSSL writes with write(), which has no MSG_NOSIGNAL
+        endpoint.erase(0, 4);
+        transport.reset(new TlsTransport(tlsContext));
+#else
+        std::cout << "This client was built without TLS support (compile with -DBURGER_TLS)." << std::endl;
         return 1;
+#endif
+    } else {
+        transport = transportFor(endpoint);
     }
-
-    // Connect to server
-    if (connect(sock, (struct sockaddr *)&serv_addr, sizeof(serv_addr)) < 0) {
+    if (tls || dynamic_cast<TcpTransport*>(transport.get()) != nullptr) {
+        sockaddr_in probe{};
+        if (inet_pton(AF_INET, endpoint.c_str(), &probe.sin_addr) <= 0) {
+            std::cout << "\nInvalid address/ Address not supported \n";
+            return 1;
+        }
+        endpoint += ":" + std::to_string(port);
+    }
+#ifdef BURGER_TLS
+    if (handshakes > 0) return tlsHandshakeBench(tlsContext, endpoint, handshakes);
+#endif
+    std::unique_ptr<Connection> connection = transport->connect(endpoint);
+    if (!connection) {
+#ifdef BURGER_TLS
+        if (tls && !lastTlsError().empty()) std::cout << "TLS handshake failed: " << lastTlsError() << std::endl;
+#endif
         std::cout << "\nConnection Failed \n";
         return 1;
     }
 
+    if (display) return followDisplayFeed(*connection);
+
     // Seed for random number generation
     srand(time(nullptr));
 
     // Send orders to server and receive responses
+    MessageParser parser;
     for (int i = 0; i < maxOrders; ++i) {
-        const char* orderMessage = "Order";
-        if (send(sock, orderMessage, strlen(orderMessage), 0) < 0) {
+        if (!Message<MessageType::Order>::send(*connection)) {
             std::cerr << "Failed to send order. Exiting." << std::endl;
             break;
         }
         std::cout << "Ordered burger #" << i + 1 << std::endl;
 
-        char buffer[1024] = {0};
-        buffer[0] = '\0'; // Clear buffer
-        int bytesReceived = read(sock, buffer, 1024); // Wait for burger to be served
-        if (bytesReceived > 0) {
-            std::cout << "Server: " << buffer << std::endl;
-            if (strncmp(buffer, "Burger Served", 13) == 0) {
+        // Wait for burger to be served; replies may arrive split or several per read
+        MessageType reply;
+        bool gotReply = parser.next(reply);
+        while (!gotReply) {
+            size_t space;
+            char* receiveInto = parser.writeSpan(space);
+            int bytesReceived = connection->recv(receiveInto, space);
+            if (bytesReceived <= 0) break;
+            parser.commit(bytesReceived);
+            gotReply = parser.next(reply);
+        }
+        if (gotReply) {
+            std::cout << "Server: " << messageToken(reply).text << std::endl;
+            if (reply == MessageType::BurgerServed) {
                 // Simulate consuming the burger
                 int waitTimes[3] = {1, 3, 5};
                 int waitTime = waitTimes[rand() % 3];
@@ -99,7 +332,7 @@ int main(int argc, char* argv[]) {
                 if (i + 1 < maxOrders) {
                     std::cout << maxOrders - (i + 1) << " burgers left in the order." << std::endl;
                 }
-            } else if (strncmp(buffer, "No more burgers", 15) == 0) {
+            } else if (reply == MessageType::NoMoreBurgers) {
                 std::cout << "No more burgers available. Exiting." << std::endl;
                 break; // Exit if no more burgers can be served
             }
@@ -108,6 +341,5 @@ int main(int argc, char* argv[]) {
             break; // Exit if there's an issue receiving server response
         }
     }
-    close(sock);
     return 0;
 }
\ No newline at end of file
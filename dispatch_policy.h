@@ -0,0 +1,281 @@
+/**
+ * @file dispatch_policy.h
+ * @brief Policies for choosing which waiting order gets the next ready burger.
+ *
+ * Each policy is a queue class with the same members, so the serving code is a
+ * template over the policy and each specialization is inlined into the hot
+ * path; there are no virtual calls. The server picks one at startup and keeps
+ * it in a std::variant (DispatchQueue), so the choice costs one jump per visit.
+ *
+ * An Order needs a client member, compared by value to tell clients apart,
+ * and an int priority member in [0, kPriorityLevels), 0 being served first.
+ *
+ * @author Michael Barry
+ */
+
+#ifndef BURGER_DISPATCH_POLICY_H
+#define BURGER_DISPATCH_POLICY_H
+
+#include <algorithm>
+#include <cstddef>
+#include <deque>
+#include <map>
+#include <set>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <variant>
+
+constexpr int kPriorityLevels = 2; // Priority classes known to PriorityDispatch
+
+/**
+ * @brief Serves orders in arrival order, whoever placed them.
+ */
+template <typename Order>
+class FifoDispatch {
+public:
+    static constexpr const char* kName = "fifo";
+
+    bool empty() const { return orders.empty(); }
+    size_t size() const { return orders.size(); }
+    void push(const Order& order) { orders.push_back(order); }
+
+    Order pop() {
+        Order order = orders.front();
+        orders.pop_front();
+        return order;
+    }
+
+    /**
+     * @brief Drops the orders that match, e.g. those of a client that left.
+     */
+    template <typename Predicate>
+    void removeIf(Predicate matches) {
+        orders.erase(std::remove_if(orders.begin(), orders.end(), matches), orders.end());
+    }
+
+    /**
+     * @brief Empties the queue, handing every order to visit oldest first.
+     */
+    template <typename Visitor>
+    void drain(Visitor visit) {
+        for (const Order& order : orders) visit(order);
+        orders.clear();
+    }
+
+private:
+    std::deque<Order> orders; // Oldest first
+};
+
+/**
+ * @brief Round-robin across clients: one order per waiting client in turn, oldest first within a client.
+ *
+ * A client with many orders in flight cannot hold up one that placed a single order.
+ */
+template <typename Order>
+class FairDispatch {
+public:
+    static constexpr const char* kName = "fair";
+
+    bool empty() const { return count == 0; }
+    size_t size() const { return count; }
+
+    void push(const Order& order) {
+        std::deque<Order>& orders = byClient[order.client];
+        if (orders.empty()) turns.push_back(order.client);
+        orders.push_back(order);
+        count++;
+    }
+
+    Order pop() {
+        auto client = turns.front();
+        turns.pop_front();
+        auto entry = byClient.find(client);
+        Order order = entry->second.front();
+        entry->second.pop_front();
+        if (entry->second.empty()) {
+            byClient.erase(entry);
+        } else {
+            turns.push_back(client); // Back of the line for its next order
+        }
+        count--;
+        return order;
+    }
+
+    template <typename Predicate>
+    void removeIf(Predicate matches) {
+        for (auto entry = byClient.begin(); entry != byClient.end();) {
+            std::deque<Order>& orders = entry->second;
+            size_t before = orders.size();
+            orders.erase(std::remove_if(orders.begin(), orders.end(), matches), orders.end());
+            count -= before - orders.size();
+            if (orders.empty()) {
+                turns.erase(std::find(turns.begin(), turns.end(), entry->first));
+                entry = byClient.erase(entry);
+            } else {
+                ++entry;
+            }
+        }
+    }
+
+    template <typename Visitor>
+    void drain(Visitor visit) {
+        while (!empty()) visit(pop());
+    }
+
+private:
+    using Client = decltype(Order::client);
+    std::map<Client, std::deque<Order>> byClient; // Waiting orders of each client, oldest first
+    std::deque<Client> turns; // Clients with waiting orders, next to be served first
+    size_t count = 0; // Orders in all queues
+};
+
+/**
+ * @brief Serves the most urgent priority class first, in arrival order within a class.
+ */
+template <typename Order>
+class PriorityDispatch {
+public:
+    static constexpr const char* kName = "priority";
+
+    bool empty() const { return count == 0; }
+    size_t size() const { return count; }
+
+    void push(const Order& order) {
+        levels[std::min(std::max(order.priority, 0), kPriorityLevels - 1)].push_back(order);
+        count++;
+    }
+
+    Order pop() {
+        std::deque<Order>* level = levels;
+        while (level->empty()) ++level;
+        Order order = level->front();
+        level->pop_front();
+        count--;
+        return order;
+    }
+
+    template <typename Predicate>
+    void removeIf(Predicate matches) {
+        for (std::deque<Order>& level : levels) {
+            size_t before = level.size();
+            level.erase(std::remove_if(level.begin(), level.end(), matches), level.end());
+            count -= before - level.size();
+        }
+    }
+
+    template <typename Visitor>
+    void drain(Visitor visit) {
+        while (!empty()) visit(pop());
+    }
+
+private:
+    std::deque<Order> levels[kPriorityLevels]; // Waiting orders by priority, oldest first
+    size_t count = 0; // Orders in all levels
+};
+
+/**
+ * @brief Shortest job first: serves the client with the fewest waiting orders, so small orders finish quickly.
+ *
+ * Ties go to the client whose oldest order came first. A client's later orders
+ * queue behind its earlier ones.
+ */
+template <typename Order>
+class ShortestJobDispatch {
+public:
+    static constexpr const char* kName = "shortest";
+
+    bool empty() const { return count == 0; }
+    size_t size() const { return count; }
+
+    void push(const Order& order) {
+        Waiting& waiting = byClient[order.client];
+        if (!waiting.orders.empty()) jobs.erase(jobKey(order.client, waiting));
+        waiting.orders.push_back({order, sequence++});
+        jobs.insert(jobKey(order.client, waiting));
+        count++;
+    }
+
+    Order pop() {
+        auto client = std::get<2>(*jobs.begin());
+        jobs.erase(jobs.begin());
+        auto entry = byClient.find(client);
+        Order order = entry->second.orders.front().first;
+        entry->second.orders.pop_front();
+        if (entry->second.orders.empty()) {
+            byClient.erase(entry);
+        } else {
+            jobs.insert(jobKey(client, entry->second));
+        }
+        count--;
+        return order;
+    }
+
+    template <typename Predicate>
+    void removeIf(Predicate matches) {
+        for (auto entry = byClient.begin(); entry != byClient.end();) {
+            auto& orders = entry->second.orders;
+            jobs.erase(jobKey(entry->first, entry->second));
+            size_t before = orders.size();
+            orders.erase(std::remove_if(orders.begin(), orders.end(), [&](const std::pair<Order, long>& queued) { return matches(queued.first); }),
+                         orders.end());
+            count -= before - orders.size();
+            if (orders.empty()) {
+                entry = byClient.erase(entry);
+            } else {
+                jobs.insert(jobKey(entry->first, entry->second));
+                ++entry;
+            }
+        }
+    }
+
+    template <typename Visitor>
+    void drain(Visitor visit) {
+        while (!empty()) visit(pop());
+    }
+
+private:
+    using Client = decltype(Order::client);
+    struct Waiting {
+        std::deque<std::pair<Order, long>> orders; // Waiting orders with their arrival numbers, oldest first
+    };
+    using JobKey = std::tuple<size_t, long, Client>; // Waiting orders, oldest arrival number, client
+
+    static JobKey jobKey(const Client& client, const Waiting& waiting) {
+        return JobKey(waiting.orders.size(), waiting.orders.front().second, client);
+    }
+
+    std::map<Client, Waiting> byClient; // Waiting orders of each client
+    std::set<JobKey> jobs; // Clients with waiting orders, next to be served first
+    long sequence = 0; // Arrival number of the next order
+    size_t count = 0; // Orders in all queues
+};
+
+/**
+ * @brief The waiting orders under whichever policy was chosen at startup.
+ */
+template <typename Order>
+using DispatchQueue = std::variant<FifoDispatch<Order>, FairDispatch<Order>, PriorityDispatch<Order>, ShortestJobDispatch<Order>>;
+
+/**
+ * @brief Switches queue to the policy with the given name.
+ *
+ * @return false if no policy has that name.
+ */
+template <typename Order>
+bool selectDispatchPolicy(DispatchQueue<Order>& queue, const std::string& name) {
+    if (name == FifoDispatch<Order>::kName) {
+        queue.template emplace<FifoDispatch<Order>>();
+    } else if (name == FairDispatch<Order>::kName) {
+        queue.template emplace<FairDispatch<Order>>();
+    } else if (name == PriorityDispatch<Order>::kName) {
+        queue.template emplace<PriorityDispatch<Order>>();
+    } else if (name == ShortestJobDispatch<Order>::kName) {
+        queue.template emplace<ShortestJobDispatch<Order>>();
+    } else {
+        return false;
+    }
+    return true;
+}
+
+#endif // BURGER_DISPATCH_POLICY_H
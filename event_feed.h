@@ -0,0 +1,124 @@
+/**
+ * @file event_feed.h
+ * @brief Publish/subscribe feed of order lifecycle events for kitchen displays.
+ *
+ * Each event is formatted once into an immutable shared buffer and stored in a
+ * fixed ring. Publishing is O(1) whatever the number of subscribers: it never
+ * copies per subscriber and never waits for one. Each subscriber keeps its own
+ * cursor into the ring and pulls the events it has not seen, sharing the buffers.
+ * A subscriber that falls a whole ring behind has lost events and is dropped.
+ *
+ * @author Michael Barry
+ */
+
+#ifndef BURGER_EVENT_FEED_H
+#define BURGER_EVENT_FEED_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+constexpr size_t kDefaultFeedCapacity = 4096; // Events a subscriber may fall behind before it is dropped
+constexpr int kFeedLingerMs = 20; // Subscribers collect events this long after a partial batch, so a busy feed wakes each one at most this often
+
+/**
+ * @brief A bounded multi-publisher, multi-subscriber event ring.
+ */
+class EventFeed {
+public:
+    using Event = std::shared_ptr<const std::string>;
+
+    explicit EventFeed(size_t capacity = kDefaultFeedCapacity) : ring(capacity) {}
+
+    /**
+     * @brief Whether anyone is listening; publishers skip formatting events when not.
+     */
+    bool hasSubscribers() const { return subscribers.load(std::memory_order_relaxed) > 0; }
+
+    /**
+     * @brief Registers a subscriber.
+     * @return The subscriber's starting cursor: only events published from now on.
+     */
+    uint64_t subscribe() {
+        std::lock_guard<std::mutex> lock(mutex);
+        subscribers++;
+        return next;
+    }
+
+    /**
+     * @brief Unregisters a subscriber.
+     */
+    void unsubscribe() { subscribers--; }
+
+    /**
+     * @brief Publishes one event as "Event <Seq> <text>\n".
+     */
+    void publish(const std::string& text) {
+        // Allocated before taking the lock subscribers read under; only the
+        // sequence number is filled in there, into capacity reserved for it
+        static const char kPrefix[] = "Event ";
+        auto event = std::make_shared<std::string>();
+        event->reserve(sizeof(kPrefix) + kMaxSequenceDigits + 1 + text.size() + 1);
+        event->append(kPrefix).append(" ").append(text).append("\n");
+        Event overwritten; // Freed after the lock is released
+        std::lock_guard<std::mutex> lock(mutex);
+        char sequence[kMaxSequenceDigits + 1];
+        int digits = snprintf(sequence, sizeof(sequence), "%llu", static_cast<unsigned long long>(next));
+        event->insert(sizeof(kPrefix) - 1, sequence, digits);
+        overwritten = std::move(event);
+        ring[next % ring.size()].swap(overwritten);
+        next++;
+        if (waiters > 0) published.notify_all();
+    }
+
+    /**
+     * @brief Takes up to max events after cursor and advances it.
+     * @param out Receives the shared event buffers (replaced, not appended).
+     * @return false if events after cursor were already overwritten: the subscriber lagged.
+     */
+    bool read(uint64_t& cursor, std::vector<Event>& out, size_t max) {
+        out.clear();
+        std::lock_guard<std::mutex> lock(mutex);
+        if (next - cursor > ring.size()) return false;
+        while (cursor < next && out.size() < max) {
+            out.push_back(ring[cursor % ring.size()]);
+            cursor++;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Waits until an event after cursor is published or timeoutMs passes.
+     */
+    void wait(uint64_t cursor, int timeoutMs) {
+        std::unique_lock<std::mutex> lock(mutex);
+        waiters++;
+        published.wait_for(lock, std::chrono::milliseconds(timeoutMs), [this, cursor] { return next > cursor; });
+        waiters--;
+    }
+
+    /**
+     * @brief Sequence number the next event will get.
+     */
+    uint64_t head() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return next;
+    }
+
+private:
+    static constexpr size_t kMaxSequenceDigits = 20; // Digits of the largest uint64_t
+    mutable std::mutex mutex; // Guards ring, next and waiters; held only to copy pointers
+    std::condition_variable published; // Signals new events to waiting subscribers
+    std::vector<Event> ring; // The most recent events, by sequence number modulo capacity
+    uint64_t next = 0; // Sequence number of the next event
+    int waiters = 0; // Subscribers blocked in wait()
+    std::atomic<int> subscribers{0}; // Registered subscribers
+};
+
+#endif // BURGER_EVENT_FEED_H
@@ -0,0 +1,93 @@
+/**
+ * @file forecast.h
+ * @brief Online demand forecasting for the kitchen's stock target.
+ *
+ * Order arrivals are counted per fixed interval and smoothed with Holt's linear
+ * method (an EWMA of the rate plus an EWMA of its trend), so a rising rush is
+ * projected forward instead of trailing behind. The forecast rate over the time
+ * a chef needs to cook gives the stock to hold: enough for the orders expected
+ * before new burgers could be ready, with a Poisson safety margin, and no more
+ * than sells before it would expire. Shared by the live server and the kitchen
+ * simulator.
+ *
+ * @author Michael Barry
+ */
+
+#ifndef BURGER_FORECAST_H
+#define BURGER_FORECAST_H
+
+#include <algorithm>
+#include <cmath>
+
+constexpr double kForecastAlpha = 0.3; // Weight of the newest interval's rate in the level
+constexpr double kForecastBeta = 0.1; // Weight of the newest level change in the trend
+constexpr double kForecastSafety = 2.0; // Standard deviations of Poisson demand kept in stock (about 98% of lead times covered)
+
+/**
+ * @brief Holt's linear forecaster over order arrival rate.
+ */
+class DemandForecaster {
+public:
+    /**
+     * @param interval Seconds per smoothing step.
+     */
+    explicit DemandForecaster(double interval) : interval(interval) {}
+
+    /**
+     * @brief Feeds the cumulative order count and closes every interval that has ended.
+     *
+     * Orders counted since the last closed interval are spread evenly over the
+     * intervals that ended since, so the caller may sample as rarely as it likes.
+     *
+     * @param now Current time in seconds.
+     * @param totalOrders Orders placed since opening.
+     */
+    void observe(double now, long totalOrders) {
+        long intervals = static_cast<long>((now - intervalStart) / interval);
+        if (intervals <= 0) return;
+        double rate = (totalOrders - intervalStartOrders) / (intervals * interval);
+        for (long i = 0; i < intervals; ++i) {
+            if (!primed) {
+                level = rate;
+                primed = true;
+                continue;
+            }
+            double previous = level;
+            level = kForecastAlpha * rate + (1 - kForecastAlpha) * (level + trend);
+            trend = kForecastBeta * (level - previous) + (1 - kForecastBeta) * trend;
+        }
+        intervalStart += intervals * interval;
+        intervalStartOrders = totalOrders;
+    }
+
+    /**
+     * @brief Forecast orders per second, ahead seconds after the last closed interval.
+     */
+    double rate(double ahead) const {
+        return std::max(0.0, level + trend * ahead / interval);
+    }
+
+    /**
+     * @brief Burgers to keep ready or cooking.
+     *
+     * @param leadTime Seconds from starting a burger to having it ready.
+     * @param freshness Seconds a ready burger keeps (0 = forever).
+     * @return At least 1, so the first order after a lull does not wait a whole lead time.
+     */
+    int stockTarget(double leadTime, double freshness) const {
+        double demand = rate(leadTime) * leadTime; // Expected orders before a burger started now is ready
+        double target = std::ceil(demand + kForecastSafety * std::sqrt(demand));
+        if (freshness > 0) target = std::min(target, std::floor(rate(leadTime) * freshness)); // More would expire unsold
+        return std::max(1, static_cast<int>(target));
+    }
+
+private:
+    double interval; // Seconds per smoothing step
+    double level = 0; // Smoothed orders per second
+    double trend = 0; // Smoothed change in level per interval
+    bool primed = false; // Whether the first interval has set the level
+    double intervalStart = 0; // When the current interval began
+    long intervalStartOrders = 0; // Orders counted when it began
+};
+
+#endif // BURGER_FORECAST_H
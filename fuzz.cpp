@@ -0,0 +1,241 @@
+/**
+ * @file fuzz.cpp
+ * @brief Fuzz driver for the protocol scanners and MessageParser.
+ *
+ * Every input is checked against a reference parse that compares each position
+ * with every token, without the first-byte table the real parsers rely on:
+ *  - each batch scanner the CPU supports must give the scalar scanner's result,
+ *    for any output limit, and the scalar result must match the reference;
+ *  - MessageParser, fed the input in random pieces and drained with a random
+ *    mix of next() and nextBatch(), must extract the reference's messages and
+ *    discard the same junk.
+ * A mismatch prints what differed, saves the input to fuzz-failure.bin and aborts.
+ *
+ * Standalone, it generates inputs from tokens, token fragments, delimiters and
+ * junk, or replays the files named on the command line. Built with
+ * -DBURGER_LIBFUZZER -fsanitize=fuzzer it is a libFuzzer target instead.
+ *
+ * @author Michael Barry
+ */
+
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+#include "message_parser.h"
+#include "scanner.h"
+
+using namespace std;
+
+/**
+ * @brief What parsing a whole stream should give.
+ */
+struct ReferenceParse {
+    vector<MessageType> messages;
+    size_t consumed = 0; // Bytes before the token still being received, if any
+    size_t discarded = 0; // Junk bytes skipped
+};
+
+/**
+ * @brief Parses a stream by trying every token at every position.
+ */
+ReferenceParse referenceParse(const char* data, size_t size) {
+    ReferenceParse parse;
+    size_t pos = 0;
+    while (pos < size) {
+        if (isMessageDelimiter(data[pos])) {
+            pos++;
+            continue;
+        }
+        bool matched = false, partial = false;
+        for (const MessageToken& token : kMessageTokens) {
+            size_t length = min(token.length, size - pos);
+            if (memcmp(data + pos, token.text, length) != 0) continue;
+            if (length < token.length) {
+                partial = true;
+                continue;
+            }
+            parse.messages.push_back(token.type);
+            pos += token.length;
+            matched = true;
+            break;
+        }
+        if (matched) continue;
+        if (partial) break;
+        pos++;
+        parse.discarded++;
+    }
+    parse.consumed = pos;
+    return parse;
+}
+
+/**
+ * @brief Saves the input that failed a check and stops.
+ */
+[[noreturn]] void fail(const char* data, size_t size, const string& what) {
+    cerr << "fuzz: " << what << " (" << size << " byte input saved to fuzz-failure.bin)" << endl;
+    ofstream("fuzz-failure.bin", ios::binary).write(data, size);
+    abort();
+}
+
+bool sameResult(const ScanResult& a, const vector<MessageType>& aOut, const ScanResult& b, const vector<MessageType>& bOut) {
+    return a.messages == b.messages && a.consumed == b.consumed && a.discarded == b.discarded &&
+           equal(aOut.begin(), aOut.begin() + a.messages, bOut.begin());
+}
+
+/**
+ * @brief Checks every scanner the CPU supports against the scalar one and the reference.
+ */
+void checkScanners(const char* data, size_t size, const ReferenceParse& expected, size_t maxOut) {
+    vector<MessageType> scalarOut(maxOut + 1), out(maxOut + 1);
+    ScanResult scalar = scanMessagesScalar(data, size, scalarOut.data(), maxOut);
+    if (maxOut > expected.messages.size() && // Room to scan past the last message
+        (scalar.messages != expected.messages.size() || scalar.consumed != expected.consumed || scalar.discarded != expected.discarded ||
+         !equal(expected.messages.begin(), expected.messages.end(), scalarOut.begin()))) {
+        fail(data, size, "scalar scanner differs from the reference parse");
+    }
+    if (scalar.messages > maxOut) fail(data, size, "scalar scanner wrote past maxOut");
+#ifdef BURGER_SCANNER_X86
+    if (__builtin_cpu_supports("sse2")) {
+        ScanResult sse2 = scanMessagesSse2(data, size, out.data(), maxOut);
+        if (!sameResult(sse2, out, scalar, scalarOut)) fail(data, size, "sse2 scanner differs from scalar, maxOut " + to_string(maxOut));
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        ScanResult avx2 = scanMessagesAvx2(data, size, out.data(), maxOut);
+        if (!sameResult(avx2, out, scalar, scalarOut)) fail(data, size, "avx2 scanner differs from scalar, maxOut " + to_string(maxOut));
+    }
+#endif
+}
+
+/**
+ * @brief Feeds the input to a MessageParser in pieces and checks what comes out.
+ */
+void checkParser(const char* data, size_t size, const ReferenceParse& expected, mt19937& rng) {
+    MessageParser parser;
+    vector<MessageType> messages;
+    MessageType batch[64];
+    for (size_t offset = 0; offset < size;) {
+        size_t space;
+        char* into = parser.writeSpan(space);
+        size_t piece = min({space, size - offset, static_cast<size_t>(1 + rng() % 300)});
+        memcpy(into, data + offset, piece);
+        parser.commit(piece);
+        offset += piece;
+        if (rng() % 2) {
+            MessageType message;
+            while (parser.next(message)) messages.push_back(message);
+        } else {
+            size_t count;
+            while ((count = parser.nextBatch(batch, 1 + rng() % 64)) > 0) messages.insert(messages.end(), batch, batch + count);
+        }
+    }
+    if (messages != expected.messages) fail(data, size, "parser messages differ from the reference parse");
+    if (parser.discardedBytes() != expected.discarded) fail(data, size, "parser discarded a different number of bytes");
+    if (parser.available() != size - expected.consumed) fail(data, size, "parser holds a different partial token");
+}
+
+/**
+ * @brief Runs every check on one input.
+ */
+void checkInput(const char* data, size_t size) {
+    mt19937 rng(static_cast<unsigned>(size * 2654435761u)); // Same pieces every time the input is replayed
+    ReferenceParse expected = referenceParse(data, size);
+    checkScanners(data, size, expected, expected.messages.size() + 1);
+    checkScanners(data, size, expected, rng() % (expected.messages.size() + 1)); // Output full before the end
+    checkParser(data, size, expected, rng);
+}
+
+#ifdef BURGER_LIBFUZZER
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    checkInput(reinterpret_cast<const char*>(data), size);
+    return 0;
+}
+#else
+
+/**
+ * @brief Builds an input from the pieces a client stream is made of, and some it should not contain.
+ */
+string generateInput(mt19937& rng, size_t maxLength) {
+    static const char kDelimiters[] = {'\n', '\r', '\0', ' '};
+    string input;
+    size_t length = rng() % (maxLength + 1);
+    while (input.size() < length) {
+        unsigned pick = rng() % 100;
+        const MessageToken& token = kMessageTokens[rng() % kMessageTypeCount];
+        if (pick < 50) {
+            input.append(token.text, token.length);
+        } else if (pick < 65) {
+            input.append(token.text, 1 + rng() % token.length); // A fragment, often a false start
+        } else if (pick < 85) {
+            input.append(1 + rng() % 40, kDelimiters[rng() % 4]); // Runs cross SIMD block boundaries
+        } else {
+            input.push_back(static_cast<char>(rng()));
+        }
+    }
+    for (size_t flips = rng() % 3; flips > 0 && !input.empty(); --flips) input[rng() % input.size()] ^= static_cast<char>(1 << (rng() % 8));
+    return input;
+}
+
+/**
+ * @brief The main function for the fuzz driver.
+ *
+ * @param argc The number of command line arguments.
+ * @param argv Options, or files to replay.
+ * @return int Returns 0 if every input passed, 1 on a usage error; a failed check aborts.
+ */
+int main(int argc, char* argv[]) {
+    long iterations = 200000;
+    unsigned seed = random_device()();
+    size_t maxLength = 4096;
+    vector<string> files;
+    bool usageError = false;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--iterations" && i + 1 < argc) {
+            iterations = atol(argv[++i]);
+        } else if (arg == "--seed" && i + 1 < argc) {
+            seed = static_cast<unsigned>(strtoul(argv[++i], nullptr, 10));
+        } else if (arg == "--max-length" && i + 1 < argc) {
+            maxLength = static_cast<size_t>(atol(argv[++i]));
+        } else if (arg.compare(0, 2, "--") != 0) {
+            files.push_back(arg);
+        } else {
+            usageError = true;
+        }
+    }
+    if (usageError || iterations < 0) {
+        cout << "Usage: " << argv[0] << " [--iterations <Count>] [--seed <Seed>] [--max-length <Bytes>] [File...]" << endl;
+        return 1;
+    }
+
+    if (!files.empty()) {
+        for (const string& file : files) {
+            ifstream in(file, ios::binary);
+            string input((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+            checkInput(input.data(), input.size());
+        }
+        cout << files.size() << " inputs passed." << endl;
+        return 0;
+    }
+
+    cout << "Fuzzing the " << scannerName() << " scanner and MessageParser with seed " << seed << "." << endl;
+    mt19937 rng(seed);
+    vector<char> buffer;
+    for (long i = 0; i < iterations; ++i) {
+        string input = generateInput(rng, maxLength);
+        // Vary the alignment the SIMD scanners see
+        buffer.resize(max(buffer.size(), input.size() + 64));
+        char* data = buffer.data() + rng() % 64;
+        memcpy(data, input.data(), input.size());
+        checkInput(data, input.size());
+    }
+    cout << iterations << " inputs passed." << endl;
+    return 0;
+}
+#endif
@@ -0,0 +1,140 @@
+/**
+ * @file intake_queue.h
+ * @brief Lock-free hand-off of decoded orders between an I/O thread and the thread that serves them.
+ *
+ * Each I/O thread owns an IntakeChannel: a single-producer/single-consumer queue
+ * of requests into the serving thread and one of replies back. Items move in
+ * batches, and, as with the shared-memory rings, a producer only writes the
+ * consumer's eventfd after the consumer has announced that it is going to
+ * sleep, so a busy hand-off costs a few cache misses and no system calls.
+ * The eventfd lets a consumer wait on several queues and sockets in one poll().
+ *
+ * @author Michael Barry
+ */
+
+#ifndef BURGER_INTAKE_QUEUE_H
+#define BURGER_INTAKE_QUEUE_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+constexpr size_t kDefaultIntakeCapacity = 4096; // Items an intake queue holds, a power of two
+
+/**
+ * @brief Bounded single-producer/single-consumer queue with an idle-only wake-up.
+ *
+ * head is only written by the producer and tail only by the consumer, each on
+ * its own cache line next to that side's cached copy of the other index, so the
+ * sides only touch each other's line when the cached copy says full or empty.
+ */
+template <typename T, size_t Capacity = kDefaultIntakeCapacity>
+class IntakeQueue {
+    static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+    static_assert(std::is_trivially_copyable<T>::value, "items are copied in and out of slots");
+
+public:
+    IntakeQueue() : event(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) {}
+    IntakeQueue(const IntakeQueue&) = delete;
+    IntakeQueue& operator=(const IntakeQueue&) = delete;
+
+    ~IntakeQueue() {
+        if (event >= 0) close(event);
+    }
+
+    /**
+     * @brief Appends as many of count items as fit, waking the consumer only if it sleeps. Producer only.
+     *
+     * @return The number of items appended; the rest did not fit.
+     */
+    size_t push(const T* items, size_t count) {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (Capacity - (h - cachedTail) < count) cachedTail = tail.load(std::memory_order_acquire);
+        size_t pushed = std::min(count, Capacity - (h - cachedTail));
+        if (pushed == 0) return 0;
+        for (size_t i = 0; i < pushed; ++i) slots[(h + i) & (Capacity - 1)] = items[i];
+        head.store(h + pushed, std::memory_order_release);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        // Only the first push after the consumer went to sleep pays for the write
+        if (consumerSleeping.load(std::memory_order_relaxed) && consumerSleeping.exchange(false, std::memory_order_relaxed)) {
+            uint64_t one = 1;
+            ssize_t ignored = write(event, &one, sizeof(one));
+            (void)ignored;
+        }
+        return pushed;
+    }
+
+    bool push(const T& item) { return push(&item, 1) == 1; }
+
+    /**
+     * @brief Removes up to max items, oldest first. Consumer only.
+     *
+     * @return The number of items copied out.
+     */
+    size_t drain(T* out, size_t max) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (cachedHead == t) cachedHead = head.load(std::memory_order_acquire);
+        size_t drained = std::min(max, cachedHead - t);
+        for (size_t i = 0; i < drained; ++i) out[i] = slots[(t + i) & (Capacity - 1)];
+        if (drained > 0) tail.store(t + drained, std::memory_order_release);
+        return drained;
+    }
+
+    /**
+     * @brief Whether the queue looked empty. Exact for the consumer; a hint for anyone else.
+     */
+    bool empty() const {
+        return head.load(std::memory_order_acquire) == tail.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief The eventfd that becomes readable when items arrive for a sleeping consumer.
+     */
+    int wakeFd() const { return event; }
+
+    /**
+     * @brief Announces that the consumer is about to poll wakeFd(). Consumer only.
+     *
+     * @return false if items arrived meanwhile; the consumer must then not sleep,
+     *         but still call wokeUp().
+     */
+    bool prepareToSleep() {
+        consumerSleeping.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        return empty();
+    }
+
+    /**
+     * @brief Ends a sleep announced by prepareToSleep() and clears any wake-up. Consumer only.
+     */
+    void wokeUp() {
+        consumerSleeping.store(false, std::memory_order_relaxed);
+        uint64_t count;
+        ssize_t ignored = read(event, &count, sizeof(count));
+        (void)ignored;
+    }
+
+private:
+    alignas(64) std::atomic<size_t> head{0}; // Items published by the producer
+    size_t cachedTail = 0; // Producer's last look at tail
+    alignas(64) std::atomic<size_t> tail{0}; // Items consumed by the consumer
+    size_t cachedHead = 0; // Consumer's last look at head
+    alignas(64) std::atomic<bool> consumerSleeping{false}; // Set while the consumer may be polling wakeFd()
+    int event; // Wakes the consumer
+    alignas(64) T slots[Capacity];
+};
+
+/**
+ * @brief The pair of queues one I/O thread shares with the serving thread.
+ */
+template <typename Request, typename Reply, size_t Capacity = kDefaultIntakeCapacity>
+struct IntakeChannel {
+    IntakeQueue<Request, Capacity> requests; // Decoded by the I/O thread, served by the serving thread
+    IntakeQueue<Reply, Capacity> replies; // Produced by the serving thread, sent by the I/O thread
+};
+
+#endif // BURGER_INTAKE_QUEUE_H
@@ -0,0 +1,132 @@
+/**
+ * @file kitchen_sim.cpp
+ * @brief Offline kitchen simulator for evaluating staffing and dispatch policies.
+ *
+ * Runs the discrete-event model from kitchen_sim.h for one configuration, or
+ * sweeps the number of chefs, and prints wait-time and utilization metrics
+ * together with the simulator's own event throughput.
+ *
+ * @author Michael Barry
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cstdlib>
+#include <string>
+#include "kitchen_sim.h"
+
+using namespace std;
+
+/**
+ * @brief Prints one result row.
+ */
+void printResult(const SimConfig& config, const SimResult& result, double wallSeconds) {
+    cout << setw(6) << (config.chefs.empty() ? config.numChefs : static_cast<int>(config.chefs.size()))
+         << setw(10) << result.ordersServed
+         << setw(12) << fixed << setprecision(1) << result.endTime
+         << setw(10) << setprecision(2) << result.meanWait
+         << setw(10) << result.p50Wait
+         << setw(10) << result.p99Wait
+         << setw(8) << setprecision(0) << result.chefUtilization * 100 << "%"
+         << setw(8) << result.maxQueueDepth
+         << setw(8) << result.burgersWasted
+         << setw(14) << setprecision(0) << result.eventsProcessed / max(wallSeconds, 1e-9)
+         << endl;
+}
+
+/**
+ * @brief The main function for the kitchen simulator.
+ *
+ * @param argc The number of command line arguments.
+ * @param argv An array of command line arguments.
+ * @return int Returns 0 on successful execution, 1 otherwise.
+ */
+int main(int argc, char* argv[]) {
+    SimConfig config;
+    int sweepChefs = 0;
+
+    // Parse command line arguments: two optional positionals followed by options
+    int positional = 0;
+    bool usageError = false;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--rate" && i + 1 < argc) {
+            config.arrivalRate = atof(argv[++i]);
+        } else if (arg == "--policy" && i + 1 < argc) {
+            string policy = argv[++i];
+            if (policy == "fifo") {
+                config.dispatch = SimDispatch::Fifo;
+            } else if (policy == "lifo") {
+                config.dispatch = SimDispatch::Lifo;
+            } else if (policy == "random") {
+                config.dispatch = SimDispatch::Random;
+            } else {
+                usageError = true;
+            }
+        } else if (arg == "--seed" && i + 1 < argc) {
+            config.seed = strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--chefs" && i + 1 < argc) {
+            string error;
+            config.chefs = loadChefProfiles(argv[++i], error);
+            if (config.chefs.empty()) {
+                cout << "Invalid chef profiles: " << error << endl;
+                return 1;
+            }
+        } else if (arg == "--batch" && i + 1 < argc) {
+            config.batchSize = atoi(argv[++i]);
+            if (config.batchSize < 1) usageError = true;
+        } else if (arg == "--freshness" && i + 1 < argc) {
+            config.freshness = atof(argv[++i]);
+        } else if (arg == "--stock-target" && i + 1 < argc) {
+            config.stockTarget = atoi(argv[++i]);
+        } else if (arg == "--forecast" && i + 1 < argc) {
+            config.forecastInterval = atof(argv[++i]);
+        } else if (arg == "--rush" && i + 1 < argc) {
+            config.rushPeriod = atof(argv[++i]);
+        } else if (arg == "--sweep" && i + 1 < argc) {
+            sweepChefs = atoi(argv[++i]);
+        } else if (arg.compare(0, 2, "--") != 0 && positional == 0) {
+            config.maxBurgers = atoi(arg.c_str());
+            positional++;
+        } else if (arg.compare(0, 2, "--") != 0 && positional == 1) {
+            config.numChefs = atoi(arg.c_str());
+            positional++;
+        } else {
+            usageError = true;
+        }
+    }
+    if (usageError || positional == 1 || config.arrivalRate <= 0 || config.numChefs < 1 || config.freshness < 0 || config.stockTarget < 0 ||
+        config.forecastInterval < 0 || config.rushPeriod < 0 ||
+        (sweepChefs > 0 && !config.chefs.empty())) {
+        cout << "Usage: " << argv[0] << " <MaxBurgers> <NumChefs> [--rate <OrdersPerSecond>]"
+             << " [--policy fifo|lifo|random] [--seed <Seed>] [--chefs <ProfileFile>] [--batch <Burgers>]"
+             << " [--freshness <Seconds>] [--stock-target <Burgers> | --forecast <IntervalSeconds>] [--rush <PeriodSeconds>]"
+             << " [--sweep <MaxChefs>]" << endl;
+        return 1;
+    }
+
+    cout << "Simulating " << config.maxBurgers << " burgers at " << config.arrivalRate << " orders/s." << endl;
+    cout << setw(6) << "Chefs" << setw(10) << "Served" << setw(12) << "Time (s)"
+         << setw(10) << "Mean" << setw(10) << "P50" << setw(10) << "P99"
+         << setw(9) << "Util" << setw(8) << "MaxQ" << setw(8) << "Wasted" << setw(14) << "Events/s" << endl;
+
+    int firstChefs = sweepChefs > 0 ? 1 : config.numChefs;
+    int lastChefs = sweepChefs > 0 ? sweepChefs : config.numChefs;
+    for (int chefs = firstChefs; chefs <= lastChefs; ++chefs) {
+        config.numChefs = chefs;
+        auto start = chrono::steady_clock::now();
+        SimResult result = KitchenSimulation(config).run();
+        double wallSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        printResult(config, result, wallSeconds);
+
+        // Per-chef breakdown for heterogeneous kitchens
+        if (!config.chefs.empty()) {
+            for (size_t chef = 0; chef < config.chefs.size(); ++chef) {
+                cout << "  " << config.chefs[chef].name << ": " << result.perChefBurgers[chef] << " burgers, "
+                     << setprecision(0) << result.perChefUtilization[chef] * 100 << "% utilization" << endl;
+            }
+        }
+    }
+    return 0;
+}
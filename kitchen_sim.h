@@ -0,0 +1,336 @@
+/**
+ * @file kitchen_sim.h
+ * @brief Discrete-event simulation of the burger shop kitchen.
+ *
+ * Runs the same model as the live server (chefs cooking into shared stock,
+ * orders served from stock as it becomes available) in virtual time, so
+ * staffing levels and dispatch policies can be evaluated offline at millions
+ * of events per second instead of in real seconds.
+ *
+ * @author Michael Barry
+ */
+
+#ifndef BURGER_KITCHEN_SIM_H
+#define BURGER_KITCHEN_SIM_H
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <queue>
+#include <random>
+#include <vector>
+#include "chef_profile.h"
+#include "forecast.h"
+
+/**
+ * @brief How a freshly prepared burger is matched to waiting orders.
+ */
+enum class SimDispatch {
+    Fifo, // Oldest waiting order first (what a fair shop does)
+    Lifo, // Newest waiting order first
+    Random // Any waiting order (what racing handler threads do)
+};
+
+constexpr const char* kSimItem = "burger"; // The only item on the simulated menu
+constexpr double kRushSwing = 0.8; // How far demand swings above and below the mean rate during rushes and lulls
+
+/**
+ * @brief Parameters of one simulation run.
+ */
+struct SimConfig {
+    int maxBurgers = 25; // Burgers the kitchen prepares before closing
+    int numChefs = 2; // Chefs cooking in parallel (ignored when chefs is set)
+    std::vector<ChefProfile> chefs; // Chef skills and shifts (empty = numChefs default chefs)
+    int batchSize = 0; // Burgers every chef grills at once (0 = as in the profiles)
+    double freshness = 0; // Seconds a ready burger may wait for an order (0 = forever)
+    int stockTarget = 0; // Ready and cooking burgers the kitchen keeps at most (0 = cook every burger right away)
+    double forecastInterval = 0; // Seconds per forecast step; a demand forecast sets the stock target (0 = stockTarget)
+    double rushPeriod = 0; // Seconds per demand cycle; arrivals swing between 0.2 and 1.8 times arrivalRate (0 = steady)
+    double arrivalRate = 0.5; // Mean orders per second (Poisson arrivals)
+    SimDispatch dispatch = SimDispatch::Fifo; // Dispatch policy for waiting orders
+    uint64_t seed = 1; // Random seed, so runs are reproducible
+};
+
+/**
+ * @brief Results of one simulation run.
+ */
+struct SimResult {
+    long ordersServed = 0; // Orders that received a burger
+    long burgersWasted = 0; // Burgers that expired before anyone ordered them
+    long eventsProcessed = 0; // Events popped from the queue
+    double endTime = 0; // Virtual time when the last burger was served
+    double meanWait = 0; // Mean seconds from order to burger
+    double p50Wait = 0; // Median wait
+    double p99Wait = 0; // 99th percentile wait
+    double chefUtilization = 0; // Fraction of on-shift chef time spent cooking
+    std::vector<double> perChefUtilization; // The same, for each chef
+    std::vector<int> perChefBurgers; // Burgers cooked by each chef
+    size_t maxQueueDepth = 0; // Most orders waiting at once
+};
+
+/**
+ * @brief A timestamped simulation event.
+ *
+ * seq breaks ties so events at the same virtual time run in scheduling order.
+ */
+struct SimEvent {
+    enum Type : uint8_t { OrderArrival, BurgerReady, ShiftStart, StockExpiry };
+
+    double time; // Virtual time in seconds
+    uint64_t seq; // Scheduling order
+    Type type; // What happens
+    int chef; // Chef that finished a burger or started a shift
+
+    bool operator>(const SimEvent& other) const {
+        return time != other.time ? time > other.time : seq > other.seq;
+    }
+};
+
+/**
+ * @brief Discrete-event kitchen simulation.
+ *
+ * Demand is steady or swings through rushes and lulls, and the stock target is
+ * fixed or follows a DemandForecaster.
+ * Burgers are assigned a grill load at a time to the chef with the earliest
+ * expected completion time (see chooseChef) until maxBurgers have been prepared,
+ * using the same profiles as the live server. Orders arrive as a Poisson process and
+ * are served immediately from stock or wait until a chef finishes. Stock is
+ * served oldest first; with a freshness window, burgers nobody ordered in time
+ * are thrown away and cooked again.
+ */
+class KitchenSimulation {
+public:
+    explicit KitchenSimulation(const SimConfig& config)
+        : config(config), rng(config.seed), forecaster(config.forecastInterval > 0 ? config.forecastInterval : 1) {
+        if (this->config.chefs.empty()) this->config.chefs = defaultChefProfiles(config.numChefs);
+        if (config.batchSize > 0) {
+            for (ChefProfile& chef : this->config.chefs) chef.batchSize = config.batchSize;
+        }
+        size_t numChefs = this->config.chefs.size();
+        freeAt.assign(numChefs, 0);
+        busy.assign(numChefs, false);
+        batch.assign(numChefs, 0);
+        busyTime.assign(numChefs, 0);
+        result.perChefBurgers.assign(numChefs, 0);
+        for (const ChefProfile& chef : this->config.chefs) leadTime += chef.meanPrep / numChefs;
+    }
+
+    /**
+     * @brief Runs the simulation until every burger is served or no more can be.
+     */
+    SimResult run() {
+        for (size_t chef = 0; chef < config.chefs.size(); ++chef) {
+            if (config.chefs[chef].shiftStart > 0) {
+                schedule(config.chefs[chef].shiftStart, SimEvent::ShiftStart, static_cast<int>(chef));
+            }
+        }
+        assignWork();
+        schedule(nextArrival(), SimEvent::OrderArrival, -1);
+
+        while (!events.empty() && result.ordersServed < config.maxBurgers) {
+            SimEvent event = events.top();
+            events.pop();
+            now = event.time;
+            result.eventsProcessed++;
+            if (event.type == SimEvent::OrderArrival) {
+                onOrderArrival();
+            } else if (event.type == SimEvent::BurgerReady) {
+                onBurgerReady(event.chef);
+            } else if (event.type == SimEvent::StockExpiry) {
+                expireStock();
+                assignWork();
+            } else {
+                assignWork();
+            }
+        }
+        return finish();
+    }
+
+private:
+    void schedule(double time, SimEvent::Type type, int chef) {
+        events.push({time, nextSeq++, type, chef});
+    }
+
+    /**
+     * @brief Mean arrival rate at time t.
+     */
+    double arrivalRate(double t) const {
+        if (config.rushPeriod <= 0) return config.arrivalRate;
+        return config.arrivalRate * (1 + kRushSwing * std::sin(2 * M_PI * t / config.rushPeriod));
+    }
+
+    /**
+     * @brief Draws the next arrival, thinning a Poisson process at the peak rate when demand swings.
+     */
+    double nextArrival() {
+        double peak = config.rushPeriod > 0 ? config.arrivalRate * (1 + kRushSwing) : config.arrivalRate;
+        double t = now;
+        do {
+            t += std::exponential_distribution<double>(peak)(rng);
+        } while (config.rushPeriod > 0 && std::uniform_real_distribution<double>(0, peak)(rng) > arrivalRate(t));
+        return t;
+    }
+
+    /**
+     * @brief Burgers to keep ready or cooking (0 = no limit).
+     *
+     * A forecast target also covers the orders already waiting, as the server's does.
+     */
+    int stockTarget() {
+        if (config.forecastInterval <= 0) return config.stockTarget;
+        forecaster.observe(now, ordersArrived);
+        return forecaster.stockTarget(leadTime, config.freshness) + static_cast<int>(waiting.size());
+    }
+
+    /**
+     * @brief Starts grill loads on idle chefs while the best chef for the next one is idle.
+     *
+     * When the best chef is busy or not yet on shift, the burger waits for them; their
+     * BurgerReady or ShiftStart event calls back in here. Expired burgers are cooked
+     * again, and a stock target holds cooking back until sales make room.
+     */
+    void assignWork() {
+        while (true) {
+            int remaining = config.maxBurgers - (burgersStarted - static_cast<int>(result.burgersWasted));
+            int allowed = remaining;
+            int target = stockTarget();
+            if (target > 0) {
+                allowed = std::min(allowed, target - (burgersStarted - static_cast<int>(result.ordersServed + result.burgersWasted)));
+            }
+            if (allowed <= 0) return;
+            for (size_t i = 0; i < freeAt.size(); ++i) {
+                if (!busy[i]) freeAt[i] = now;
+            }
+            int best = chooseChef(config.chefs, freeAt, now, kSimItem);
+            if (best < 0 || busy[best] || !config.chefs[best].onShift(now)) return;
+            double preparationTime = config.chefs[best].samplePrep(rng);
+            batch[best] = std::min(config.chefs[best].batchSize, allowed);
+            burgersStarted += batch[best];
+            busy[best] = true;
+            freeAt[best] = now + preparationTime;
+            busyTime[best] += preparationTime;
+            schedule(now + preparationTime, SimEvent::BurgerReady, best);
+        }
+    }
+
+    void onOrderArrival() {
+        expireStock();
+        ordersArrived++;
+        if (!stock.empty()) {
+            stock.pop_front();
+            serve(now);
+            if (config.stockTarget > 0 || config.forecastInterval > 0) assignWork(); // The sale made room under the target
+        } else {
+            waiting.push_back(now);
+            result.maxQueueDepth = std::max(result.maxQueueDepth, waiting.size());
+            if (config.forecastInterval > 0) assignWork(); // The waiting order raised the target
+        }
+        // Only keep generating demand while there are burgers left to sell
+        if (result.ordersServed + static_cast<long>(waiting.size()) < config.maxBurgers) {
+            schedule(nextArrival(), SimEvent::OrderArrival, -1);
+        } else {
+            arrivalsStopped = true;
+        }
+    }
+
+    void onBurgerReady(int chef) {
+        busy[chef] = false;
+        result.perChefBurgers[chef] += batch[chef];
+        for (int burger = 0; burger < batch[chef]; ++burger) {
+            if (waiting.empty()) {
+                stock.push_back(now);
+            } else {
+                serve(takeWaitingOrder());
+            }
+        }
+        if (config.freshness > 0 && !stock.empty() && stock.back() == now) {
+            schedule(now + config.freshness, SimEvent::StockExpiry, -1);
+        }
+        if (arrivalsStopped && result.ordersServed + static_cast<long>(waiting.size()) < config.maxBurgers) {
+            arrivalsStopped = false;
+            schedule(nextArrival(), SimEvent::OrderArrival, -1);
+        }
+        assignWork();
+    }
+
+    /**
+     * @brief Throws away the burgers at the front of the stock that are past the freshness window.
+     */
+    void expireStock() {
+        while (config.freshness > 0 && !stock.empty() && stock.front() + config.freshness <= now) {
+            stock.pop_front();
+            result.burgersWasted++;
+        }
+    }
+
+    double takeWaitingOrder() {
+        double orderedAt;
+        switch (config.dispatch) {
+            case SimDispatch::Lifo:
+                orderedAt = waiting.back();
+                waiting.pop_back();
+                break;
+            case SimDispatch::Random: {
+                size_t index = rng() % waiting.size();
+                orderedAt = waiting[index];
+                waiting[index] = waiting.back();
+                waiting.pop_back();
+                break;
+            }
+            default:
+                orderedAt = waiting.front();
+                waiting.pop_front();
+                break;
+        }
+        return orderedAt;
+    }
+
+    void serve(double orderedAt) {
+        waits.push_back(now - orderedAt);
+        result.ordersServed++;
+        result.endTime = now;
+    }
+
+    SimResult finish() {
+        if (!waits.empty()) {
+            double total = 0;
+            for (double wait : waits) total += wait;
+            result.meanWait = total / waits.size();
+            std::sort(waits.begin(), waits.end());
+            result.p50Wait = waits[waits.size() / 2];
+            result.p99Wait = waits[std::min(waits.size() - 1, waits.size() * 99 / 100)];
+        }
+        double totalBusy = 0;
+        double totalShift = 0;
+        for (size_t i = 0; i < config.chefs.size(); ++i) {
+            const ChefProfile& chef = config.chefs[i];
+            double shift = std::max(0.0, std::min(chef.shiftEnd, result.endTime) - chef.shiftStart);
+            result.perChefUtilization.push_back(shift > 0 ? std::min(1.0, busyTime[i] / shift) : 0);
+            totalBusy += busyTime[i];
+            totalShift += shift;
+        }
+        if (totalShift > 0) result.chefUtilization = std::min(1.0, totalBusy / totalShift);
+        return result;
+    }
+
+    SimConfig config;
+    std::mt19937_64 rng;
+    std::priority_queue<SimEvent, std::vector<SimEvent>, std::greater<SimEvent>> events; // Pending events by time
+    uint64_t nextSeq = 0; // Tie breaker for events
+    double now = 0; // Current virtual time
+    std::deque<double> stock; // When each ready burger was cooked, oldest first
+    long ordersArrived = 0; // Orders placed so far, for the forecaster
+    DemandForecaster forecaster; // Drives the stock target when forecastInterval is set
+    double leadTime = 0; // Mean seconds from starting a burger to having it ready
+    int burgersStarted = 0; // Burgers a chef has started cooking
+    std::vector<double> freeAt; // When each chef finishes their current burger
+    std::vector<bool> busy; // Whether each chef is cooking
+    std::vector<int> batch; // Burgers on each chef's grill
+    std::vector<double> busyTime; // Seconds each chef spent cooking
+    bool arrivalsStopped = false; // Whether demand is paused because every burger is spoken for
+    std::deque<double> waiting; // Arrival times of orders waiting for a burger
+    std::vector<double> waits; // Wait of every served order
+    SimResult result;
+};
+
+#endif // BURGER_KITCHEN_SIM_H
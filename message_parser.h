@@ -0,0 +1,134 @@
+/**
+ * @file message_parser.h
+ * @brief Incremental parser for the burger shop text protocol.
+ *
+ * MessageParser keeps a per-connection ring buffer that the transport receives
+ * into directly, and matches tokens in place, so no bytes are copied between
+ * the socket and the parser. Whole batches are classified with the SIMD
+ * scanner from scanner.h.
+ *
+ * @author Michael Barry
+ */
+
+#ifndef BURGER_MESSAGE_PARSER_H
+#define BURGER_MESSAGE_PARSER_H
+
+#include <algorithm>
+#include <cstddef>
+#include "protocol.h"
+#include "scanner.h"
+
+/**
+ * @brief Incremental message parser over a per-connection ring buffer.
+ *
+ * Usage: receive into writeSpan(), commit() the bytes received, then call next()
+ * until it returns false, or nextBatch() to take everything at once.
+ */
+class MessageParser {
+public:
+    static constexpr size_t kCapacity = 4096; // Ring size in bytes, a power of two
+
+    /**
+     * @brief The largest contiguous free region of the ring, for receiving into.
+     *
+     * An empty ring rewinds to the start so message-oriented transports get the
+     * whole buffer and never truncate a datagram at the wrap point.
+     *
+     * @param length Set to the size of the region.
+     */
+    char* writeSpan(size_t& length) {
+        if (head == tail) head = tail = 0;
+        size_t pos = tail & (kCapacity - 1);
+        length = std::min(kCapacity - (tail - head), kCapacity - pos);
+        return data + pos;
+    }
+
+    /**
+     * @brief Marks bytes received into writeSpan() as readable.
+     */
+    void commit(size_t length) { tail += length; }
+
+    /**
+     * @brief Extracts the next complete message.
+     *
+     * Delimiters are skipped and bytes that cannot start a known token are
+     * discarded one at a time until the stream resynchronizes.
+     *
+     * @param type Set to the message type.
+     * @return false once the buffer holds no further complete message.
+     */
+    bool next(MessageType& type) {
+        while (head != tail) {
+            char first = at(0);
+            if (isMessageDelimiter(first)) {
+                head++;
+                continue;
+            }
+            if (isTokenStart(first)) {
+                const MessageToken& token = tokenStartingWith(first); // The only token that can match here
+                size_t matched = matchLength(token);
+                if (matched == token.length) {
+                    head += token.length;
+                    type = token.type;
+                    return true;
+                }
+                if (matched == available()) return false; // Wait for the rest of the token
+            }
+            head++; // Not the start of any token: resynchronize
+            discarded++;
+        }
+        return false;
+    }
+
+    /**
+     * @brief Extracts every complete message currently buffered, up to maxOut.
+     *
+     * Each contiguous part of the ring is classified in one scanner call; only a
+     * token straddling the wrap point goes through next().
+     *
+     * @return Number of messages written to out.
+     */
+    size_t nextBatch(MessageType* out, size_t maxOut) {
+        size_t count = 0;
+        while (count < maxOut && head != tail) {
+            size_t pos = head & (kCapacity - 1);
+            size_t contiguous = std::min(available(), kCapacity - pos);
+            ScanResult result = scanMessages(data + pos, contiguous, out + count, maxOut - count);
+            head += result.consumed;
+            discarded += result.discarded;
+            count += result.messages;
+            if (result.consumed == contiguous) continue; // Carry on after the wrap point
+            if (count == maxOut || contiguous == available() + result.consumed) break; // Full, or a partial token at the end
+            if (!next(out[count])) break; // Token straddles the wrap point
+            count++;
+        }
+        return count;
+    }
+
+    /**
+     * @brief Bytes received but not yet parsed.
+     */
+    size_t available() const { return tail - head; }
+
+    /**
+     * @brief Bytes thrown away because they did not form a message.
+     */
+    size_t discardedBytes() const { return discarded; }
+
+private:
+    char at(size_t offset) const { return data[(head + offset) & (kCapacity - 1)]; }
+
+    size_t matchLength(const MessageToken& token) const {
+        size_t limit = std::min(token.length, available());
+        size_t matched = 0;
+        while (matched < limit && at(matched) == token.text[matched]) matched++;
+        return matched;
+    }
+
+    char data[kCapacity]; // Ring storage
+    size_t head = 0; // Free-running read position
+    size_t tail = 0; // Free-running write position
+    size_t discarded = 0; // Junk bytes skipped so far
+};
+
+#endif // BURGER_MESSAGE_PARSER_H
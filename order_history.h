@@ -0,0 +1,309 @@
+/**
+ * @file order_history.h
+ * @brief Compact in-memory record of every client's orders.
+ *
+ * Each client's orders are kept in append-only chunks of columns rather than
+ * as one struct per order. A chunk stores the time of its first order, then
+ * each later order's distance in microseconds from the previous one as a
+ * zigzag varint: one or two bytes for orders milliseconds apart, three or
+ * four for orders seconds to minutes apart. Item names are replaced by small
+ * dictionary ids and share their byte with the order's outcome, so an order
+ * costs a few bytes rather than a struct, and millions fit in tens of
+ * megabytes. Chunks remember their time span, so a time-range query skips the
+ * chunks outside it without decoding them.
+ *
+ * Clients are spread over lock stripes; a recording thread only contends with
+ * another thread recording for a client in the same stripe, or with a query
+ * reading that stripe. Records are best handed over in batches, which take each
+ * stripe's lock once per run of records in it.
+ *
+ * The history is bounded for long-running servers: a client keeps its newest
+ * kHistoryMaxChunks chunks, and each stripe forgets its longest-known client
+ * once it holds its share of kHistoryMaxClients.
+ *
+ * @author Michael Barry
+ */
+
+#ifndef BURGER_ORDER_HISTORY_H
+#define BURGER_ORDER_HISTORY_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+constexpr size_t kHistoryChunkOrders = 4096; // Orders per chunk before it is sealed
+constexpr size_t kHistoryStripes = 16; // Lock stripes clients are spread over
+constexpr size_t kHistoryMaxItems = 128; // Distinct item names the dictionary holds
+constexpr size_t kHistoryMaxChunks = 16; // Chunks kept per client; the oldest is dropped for a new one
+constexpr size_t kHistoryMaxClients = 65536; // Clients kept; a full stripe forgets its longest-known client
+
+/**
+ * @brief How an order was answered.
+ */
+enum class OrderOutcome : uint8_t {
+    Served, // The client got its item
+    Refused // The shop sold out first
+};
+
+/**
+ * @brief One decoded order.
+ */
+struct HistoryEntry {
+    int64_t micros; // When it was placed, on the recorder's clock
+    uint8_t item; // Dictionary id, see OrderHistory::itemName()
+    OrderOutcome outcome;
+};
+
+/**
+ * @brief One order to record, as handed to OrderHistory::record() in batches.
+ */
+struct HistoryRecord {
+    uint64_t client;
+    int64_t micros; // When it was placed; any clock, as long as the queries use it too
+    uint8_t item;
+    OrderOutcome outcome;
+};
+
+/**
+ * @brief A client's order counts, as ranked by OrderHistory::topClients().
+ */
+struct ClientTotals {
+    uint64_t client;
+    long orders;
+    long served;
+};
+
+/**
+ * @brief Per-client order history in columnar, delta-encoded chunks.
+ */
+class OrderHistory {
+public:
+    /**
+     * @brief Memory held by the history.
+     */
+    struct Usage {
+        size_t clients;
+        long orders; // Orders kept, not those dropped by the retention limits
+        size_t bytes; // Chunk columns and bookkeeping, excluding allocator overhead
+    };
+
+    /**
+     * @brief The dictionary id of an item name, adding it if new.
+     *
+     * Intern names once, e.g. at startup, and record with the id.
+     * @return The id, or kHistoryMaxItems - 1 for every name past the dictionary's capacity.
+     */
+    uint8_t itemId(const std::string& name) {
+        std::lock_guard<std::mutex> lock(itemsMtx);
+        auto known = std::find(items.begin(), items.end(), name);
+        if (known != items.end()) return static_cast<uint8_t>(known - items.begin());
+        if (items.size() == kHistoryMaxItems - 1) items.push_back("other");
+        if (items.size() == kHistoryMaxItems) return kHistoryMaxItems - 1;
+        items.push_back(name);
+        return static_cast<uint8_t>(items.size() - 1);
+    }
+
+    std::string itemName(uint8_t id) const {
+        std::lock_guard<std::mutex> lock(itemsMtx);
+        return id < items.size() ? items[id] : "?";
+    }
+
+    /**
+     * @brief Appends a batch of orders to their clients' histories.
+     *
+     * Takes a stripe's lock once for each run of records that fall in it, and
+     * looks a client up once for each run of its records.
+     */
+    void record(const HistoryRecord* records, size_t count) {
+        for (size_t i = 0; i < count;) {
+            Stripe& stripe = stripeOf(records[i].client);
+            std::lock_guard<std::mutex> lock(stripe.mtx);
+            ClientHistory* history = nullptr;
+            for (; i < count && &stripeOf(records[i].client) == &stripe; ++i) {
+                const HistoryRecord& order = records[i];
+                if (!history || order.client != records[i - 1].client) history = &clientOf(stripe, order.client);
+                history->append(order);
+            }
+        }
+    }
+
+    /**
+     * @brief Appends one order to a client's history.
+     */
+    void record(uint64_t client, int64_t micros, uint8_t item, OrderOutcome outcome) {
+        HistoryRecord order{client, micros, item, outcome};
+        record(&order, 1);
+    }
+
+    /**
+     * @brief Hands visit every order of a client placed in [from, to], oldest chunk first.
+     *
+     * Holds the client's stripe while decoding, so keep visit cheap.
+     * @return The number of orders visited.
+     */
+    template <typename Visitor>
+    size_t ordersOf(uint64_t client, int64_t from, int64_t to, Visitor visit) const {
+        const Stripe& stripe = stripeOf(client);
+        std::lock_guard<std::mutex> lock(stripe.mtx);
+        auto entry = stripe.clients.find(client);
+        if (entry == stripe.clients.end()) return 0;
+        size_t visited = 0;
+        for (const Chunk& chunk : entry->second.chunks) {
+            if (chunk.maxMicros < from || chunk.minMicros > to) continue; // Nothing in range
+            int64_t micros = chunk.firstMicros;
+            size_t offset = 0;
+            for (size_t i = 0; i < chunk.count; ++i) {
+                if (i > 0) micros += readDelta(chunk.deltas, offset);
+                if (micros < from || micros > to) continue;
+                uint8_t code = chunk.codes[i];
+                visit(HistoryEntry{micros, static_cast<uint8_t>(code & ~kRefusedBit),
+                                   code & kRefusedBit ? OrderOutcome::Refused : OrderOutcome::Served});
+                visited++;
+            }
+        }
+        return visited;
+    }
+
+    /**
+     * @brief The count clients with the most orders, most first; ties go to the lower client id.
+     */
+    std::vector<ClientTotals> topClients(size_t count) const {
+        std::vector<ClientTotals> totals;
+        for (const Stripe& stripe : stripes) {
+            std::lock_guard<std::mutex> lock(stripe.mtx);
+            for (const auto& entry : stripe.clients) totals.push_back({entry.first, entry.second.orders, entry.second.served});
+        }
+        auto ranksBefore = [](const ClientTotals& a, const ClientTotals& b) {
+            return a.orders != b.orders ? a.orders > b.orders : a.client < b.client;
+        };
+        count = std::min(count, totals.size());
+        std::partial_sort(totals.begin(), totals.begin() + count, totals.end(), ranksBefore);
+        totals.resize(count);
+        return totals;
+    }
+
+    Usage usage() const {
+        Usage usage{0, 0, 0};
+        for (const Stripe& stripe : stripes) {
+            std::lock_guard<std::mutex> lock(stripe.mtx);
+            usage.clients += stripe.clients.size();
+            usage.bytes += stripe.arrivals.size() * sizeof(uint64_t);
+            for (const auto& entry : stripe.clients) {
+                const ClientHistory& history = entry.second;
+                usage.bytes += sizeof(entry) + sizeof(void*) + history.chunks.capacity() * sizeof(Chunk); // Hash node and chunk list
+                for (const Chunk& chunk : history.chunks) {
+                    usage.orders += chunk.count;
+                    usage.bytes += chunk.deltas.capacity() + chunk.codes.capacity();
+                }
+            }
+        }
+        return usage;
+    }
+
+private:
+    static constexpr uint8_t kRefusedBit = 0x80; // Set in a code byte for a refused order; the rest is the item id
+    static_assert(kHistoryMaxItems <= kRefusedBit, "item ids must leave the outcome bit free");
+
+    /**
+     * @brief Up to kHistoryChunkOrders orders of one client, as columns.
+     */
+    struct Chunk {
+        int64_t firstMicros = 0; // Time of the first order
+        int64_t lastMicros = 0; // Time of the latest order, the base of the next delta
+        int64_t minMicros = std::numeric_limits<int64_t>::max(); // Time span, for skipping chunks
+        int64_t maxMicros = std::numeric_limits<int64_t>::min();
+        uint32_t count = 0; // Orders in the chunk
+        std::vector<uint8_t> deltas; // Zigzag varint distance of each order after the first from the one before
+        std::vector<uint8_t> codes; // Item id and outcome bit of each order
+
+        void append(int64_t micros, uint8_t code) {
+            if (count == 0) {
+                firstMicros = micros;
+            } else {
+                // Orders answered out of turn may go back in time, hence zigzag
+                int64_t delta = micros - lastMicros;
+                uint64_t zigzag = (static_cast<uint64_t>(delta) << 1) ^ static_cast<uint64_t>(delta >> 63);
+                while (zigzag >= 0x80) {
+                    deltas.push_back(static_cast<uint8_t>(zigzag | 0x80));
+                    zigzag >>= 7;
+                }
+                deltas.push_back(static_cast<uint8_t>(zigzag));
+            }
+            codes.push_back(code);
+            lastMicros = micros;
+            minMicros = std::min(minMicros, micros);
+            maxMicros = std::max(maxMicros, micros);
+            count++;
+        }
+
+        /**
+         * @brief Gives back the columns' spare capacity once the chunk is full.
+         */
+        void seal() {
+            deltas.shrink_to_fit();
+            codes.shrink_to_fit();
+        }
+    };
+
+    struct ClientHistory {
+        std::vector<Chunk> chunks; // Oldest first; only the last one grows
+        long orders = 0; // Every order recorded, including those in dropped chunks
+        long served = 0;
+
+        void append(const HistoryRecord& order) {
+            if (chunks.empty() || chunks.back().count == kHistoryChunkOrders) {
+                if (!chunks.empty()) chunks.back().seal();
+                if (chunks.size() == kHistoryMaxChunks) chunks.erase(chunks.begin()); // Retention: drop the oldest sealed chunk
+                chunks.emplace_back();
+            }
+            chunks.back().append(order.micros, static_cast<uint8_t>(order.item | (order.outcome == OrderOutcome::Refused ? kRefusedBit : 0)));
+            orders++;
+            if (order.outcome == OrderOutcome::Served) served++;
+        }
+    };
+
+    struct alignas(64) Stripe {
+        mutable std::mutex mtx; // Guards clients and arrivals
+        std::unordered_map<uint64_t, ClientHistory> clients;
+        std::deque<uint64_t> arrivals; // Clients in the order they were first recorded, for retention
+    };
+
+    /**
+     * @brief A client's history, forgetting the stripe's longest-known client to make room for a new one.
+     */
+    static ClientHistory& clientOf(Stripe& stripe, uint64_t client) {
+        auto known = stripe.clients.find(client);
+        if (known != stripe.clients.end()) return known->second;
+        if (stripe.clients.size() == kHistoryMaxClients / kHistoryStripes) {
+            stripe.clients.erase(stripe.arrivals.front());
+            stripe.arrivals.pop_front();
+        }
+        stripe.arrivals.push_back(client);
+        return stripe.clients[client];
+    }
+
+    static int64_t readDelta(const std::vector<uint8_t>& deltas, size_t& offset) {
+        uint64_t zigzag = 0;
+        for (int shift = 0;; shift += 7) {
+            uint8_t byte = deltas[offset++];
+            zigzag |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) break;
+        }
+        return static_cast<int64_t>(zigzag >> 1) ^ -static_cast<int64_t>(zigzag & 1);
+    }
+
+    Stripe& stripeOf(uint64_t client) { return stripes[((client * 0x9e3779b97f4a7c15ULL) >> 32) % kHistoryStripes]; }
+    const Stripe& stripeOf(uint64_t client) const { return stripes[((client * 0x9e3779b97f4a7c15ULL) >> 32) % kHistoryStripes]; }
+
+    Stripe stripes[kHistoryStripes];
+    mutable std::mutex itemsMtx; // Guards items
+    std::vector<std::string> items; // Item names by dictionary id
+};
+
+#endif // BURGER_ORDER_HISTORY_H
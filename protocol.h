@@ -0,0 +1,231 @@
+/**
+ * @file protocol.h
+ * @brief Messages of the burger shop text protocol.
+ *
+ * Messages are short command tokens ("Order", "Burger Served", ...). They may be
+ * separated by newlines, NULs or spaces, but legacy clients send bare tokens
+ * with no delimiter at all, so tokens are also self-delimiting: "OrderOrder"
+ * is two orders. A stream read can therefore hold a fragment of a message or
+ * many messages at once.
+ *
+ * Every token is defined once, in the tables below. Their lengths, the lookup by
+ * type, the first-byte dispatch table and the Message<> encoders and decoders
+ * are all derived from those tables at compile time, and static_asserts reject
+ * a table the scanners could not handle, so client and server cannot drift.
+ *
+ * @author Michael Barry
+ */
+
+#ifndef BURGER_PROTOCOL_H
+#define BURGER_PROTOCOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * @brief The messages of the protocol.
+ */
+enum class MessageType : uint8_t {
+    Order, // Client asks for a burger
+    ShmRing, // Client asks to move onto a shared-memory ring
+    KitchenDisplay, // Client asks to follow order status events instead of ordering
+    BurgerServed, // Server hands over a burger
+    NoMoreBurgers // Server is out of burgers
+};
+
+/**
+ * @brief Handshake messages, exchanged one per read on a control socket and never scanned from an order stream.
+ */
+enum class ControlType : uint8_t {
+    ShmRingAccepted, // Server passes the descriptors of a new shared-memory ring
+    ShmRingRefused, // Server will not set up a ring on this connection, which carries on as it is
+    Takeover, // New server asks the running one for its shop and listeners
+    Handoff, // Running server passes them, described by the rest of the message
+    TakeoverAccepted, // New server now serves the inherited listeners
+    KitchenClosed // Running server's dispatcher has stopped; the new one may start
+};
+
+/**
+ * @brief The token that represents a message on the wire.
+ */
+template <typename Type>
+struct WireToken {
+    Type type;
+    const char* text;
+    size_t length;
+};
+
+using MessageToken = WireToken<MessageType>;
+using ControlToken = WireToken<ControlType>;
+
+/**
+ * @brief Defines a token, taking its length from the literal.
+ */
+template <typename Type, size_t N>
+constexpr WireToken<Type> defineToken(Type type, const char (&text)[N]) {
+    return {type, text, N - 1};
+}
+
+/**
+ * @brief Message tokens, in MessageType order.
+ */
+constexpr MessageToken kMessageTokens[] = {
+    defineToken(MessageType::Order, "Order"),
+    defineToken(MessageType::ShmRing, "ShmRing"),
+    defineToken(MessageType::KitchenDisplay, "Kitchen Display"),
+    defineToken(MessageType::BurgerServed, "Burger Served"),
+    defineToken(MessageType::NoMoreBurgers, "No more burgers"),
+};
+
+/**
+ * @brief Control tokens, in ControlType order.
+ */
+constexpr ControlToken kControlTokens[] = {
+    defineToken(ControlType::ShmRingAccepted, "ShmRing OK"),
+    defineToken(ControlType::ShmRingRefused, "Shared memory refused"), // Contains no message token, as it may reach an order stream
+    defineToken(ControlType::Takeover, "Takeover"),
+    defineToken(ControlType::Handoff, "Handoff "),
+    defineToken(ControlType::TakeoverAccepted, "Takeover OK"),
+    defineToken(ControlType::KitchenClosed, "Kitchen closed"),
+};
+
+constexpr size_t kMessageTypeCount = sizeof(kMessageTokens) / sizeof(kMessageTokens[0]);
+
+/**
+ * @brief The wire text of a message type.
+ */
+constexpr const MessageToken& messageToken(MessageType type) {
+    return kMessageTokens[static_cast<size_t>(type)];
+}
+
+/**
+ * @brief The wire text of a control message.
+ */
+constexpr const ControlToken& messageToken(ControlType type) {
+    return kControlTokens[static_cast<size_t>(type)];
+}
+
+/**
+ * @brief Whether a byte separates messages.
+ */
+constexpr bool isMessageDelimiter(char c) {
+    return c == '\n' || c == '\r' || c == '\0' || c == ' ';
+}
+
+/**
+ * @brief Whether a token table lists its types in declaration order, so messageToken() can index it.
+ */
+template <typename Type, size_t N>
+constexpr bool tokensInTypeOrder(const WireToken<Type> (&tokens)[N]) {
+    for (size_t i = 0; i < N; ++i) {
+        if (static_cast<size_t>(tokens[i].type) != i || tokens[i].length == 0) return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Whether every message token has its own first byte and none starts with a delimiter.
+ */
+constexpr bool messageTokensScannable() {
+    for (size_t i = 0; i < kMessageTypeCount; ++i) {
+        if (isMessageDelimiter(kMessageTokens[i].text[0])) return false;
+        for (size_t j = 0; j < i; ++j) {
+            if (kMessageTokens[i].text[0] == kMessageTokens[j].text[0]) return false;
+        }
+    }
+    return true;
+}
+
+static_assert(tokensInTypeOrder(kMessageTokens) && kMessageTypeCount == static_cast<size_t>(MessageType::NoMoreBurgers) + 1,
+              "kMessageTokens must list every MessageType in declaration order");
+static_assert(tokensInTypeOrder(kControlTokens) &&
+                  sizeof(kControlTokens) / sizeof(kControlTokens[0]) == static_cast<size_t>(ControlType::KitchenClosed) + 1,
+              "kControlTokens must list every ControlType in declaration order");
+static_assert(messageTokensScannable(), "the scanners pick the only candidate token by its first byte");
+
+/**
+ * @brief Maps a first byte to the index of the token it starts, or -1.
+ *
+ * Token first characters are distinct, so one lookup identifies the only
+ * token worth comparing against.
+ */
+struct TokenStartTable {
+    signed char index[256];
+};
+
+constexpr TokenStartTable makeTokenStartTable() {
+    TokenStartTable table{};
+    for (int c = 0; c < 256; ++c) table.index[c] = -1;
+    for (size_t i = 0; i < kMessageTypeCount; ++i) {
+        table.index[static_cast<unsigned char>(kMessageTokens[i].text[0])] = static_cast<signed char>(i);
+    }
+    return table;
+}
+
+constexpr TokenStartTable kTokenStarts = makeTokenStartTable();
+
+/**
+ * @brief Whether a byte can start a protocol token.
+ */
+constexpr bool isTokenStart(char c) {
+    return kTokenStarts.index[static_cast<unsigned char>(c)] >= 0;
+}
+
+/**
+ * @brief The only token that can start with a byte; the caller checks isTokenStart() first.
+ */
+constexpr const MessageToken& tokenStartingWith(char c) {
+    return kMessageTokens[kTokenStarts.index[static_cast<unsigned char>(c)]];
+}
+
+/**
+ * @brief Compile-time codec for one message or control message.
+ *
+ * Sending and recognizing a known message needs no table lookup and no strlen:
+ * Message<MessageType::Order>::send(connection).
+ */
+template <auto Type>
+struct Message {
+    static constexpr const char* text = messageToken(Type).text; // Wire text, NUL-terminated
+    static constexpr size_t length = messageToken(Type).length; // Wire length, without the NUL
+
+    /**
+     * @brief Sends the message through anything with send(const char*, size_t), such as a Connection.
+     */
+    template <typename Sink>
+    static bool send(Sink& sink) {
+        return sink.send(text, length);
+    }
+
+    /**
+     * @brief The message as a string, for reply lists.
+     */
+    static std::string str() {
+        return std::string(text, length);
+    }
+
+    /**
+     * @brief Whether data begins with the message, e.g. a control message followed by arguments.
+     */
+    static constexpr bool prefixOf(const char* data, size_t size) {
+        if (size < length) return false;
+        for (size_t i = 0; i < length; ++i) {
+            if (data[i] != text[i]) return false;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Whether data is exactly the message.
+     */
+    static constexpr bool matches(const char* data, size_t size) {
+        return size == length && prefixOf(data, size);
+    }
+
+    static bool matches(const std::string& data) {
+        return matches(data.data(), data.size());
+    }
+};
+
+#endif // BURGER_PROTOCOL_H
@@ -0,0 +1,202 @@
+/**
+ * @file scanner.h
+ * @brief SIMD batch scanner for the legacy text protocol.
+ *
+ * Classifies every complete message in a contiguous receive buffer in one call.
+ * The vector versions compare 16 (SSE2) or 32 (AVX2) bytes at a time against the
+ * first characters of the protocol tokens, jump straight to the next candidate
+ * and only then verify the whole token, so runs of delimiters and junk cost a
+ * fraction of a cycle per byte. The implementation is picked at runtime from what
+ * the CPU supports, with a scalar fallback that has identical results.
+ *
+ * @author Michael Barry
+ */
+
+#ifndef BURGER_SCANNER_H
+#define BURGER_SCANNER_H
+
+#include <cstddef>
+#include <cstring>
+#include "protocol.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BURGER_SCANNER_X86 1
+#endif
+
+/**
+ * @brief Result of scanning one buffer.
+ */
+struct ScanResult {
+    size_t messages = 0; // Messages written to the output array
+    size_t consumed = 0; // Bytes fully parsed; the rest is a token still being received
+    size_t discarded = 0; // Junk bytes skipped
+};
+
+/**
+ * @brief Signature shared by every scanner implementation.
+ */
+using ScanFunction = ScanResult (*)(const char* data, size_t len, MessageType* out, size_t maxOut);
+
+/**
+ * @brief Handles one candidate token start at pos, shared by all implementations.
+ *
+ * Emits the token if it is complete, skips the byte as junk if it cannot start
+ * a token, and stops at a token that is still being received.
+ *
+ * @return false when scanning must stop (partial token or output full).
+ */
+inline bool scanCandidate(const char* data, size_t len, size_t& pos, MessageType* out, size_t maxOut, ScanResult& result) {
+    const MessageToken& token = tokenStartingWith(data[pos]);
+    size_t left = len - pos;
+    if (left >= token.length) {
+        if (memcmp(data + pos, token.text, token.length) == 0) {
+            out[result.messages++] = token.type;
+            pos += token.length;
+            result.consumed = pos;
+            return result.messages < maxOut;
+        }
+    } else if (memcmp(data + pos, token.text, left) == 0) {
+        return false; // Wait for the rest of the token
+    }
+    pos++; // A token start character that starts no token is junk
+    result.discarded++;
+    result.consumed = pos;
+    return true;
+}
+
+/**
+ * @brief Byte-at-a-time reference scanner.
+ */
+inline ScanResult scanMessagesScalar(const char* data, size_t len, MessageType* out, size_t maxOut) {
+    ScanResult result;
+    size_t pos = 0;
+    while (pos < len && result.messages < maxOut) {
+        char c = data[pos];
+        if (!isTokenStart(c)) {
+            if (!isMessageDelimiter(c)) result.discarded++;
+            pos++;
+            result.consumed = pos;
+            continue;
+        }
+        if (!scanCandidate(data, len, pos, out, maxOut, result)) break;
+    }
+    return result;
+}
+
+#ifdef BURGER_SCANNER_X86
+
+/**
+ * @brief SSE2 scanner: finds the next candidate token start 16 bytes at a time.
+ *
+ * Back-to-back tokens are checked directly; only gaps are searched with vectors.
+ * Junk between candidates is counted with a popcount of the non-delimiter mask.
+ */
+__attribute__((target("sse2,popcnt"))) inline ScanResult scanMessagesSse2(const char* data, size_t len, MessageType* out, size_t maxOut) {
+    ScanResult result;
+    size_t pos = 0;
+    while (pos < len && result.messages < maxOut) {
+        if (pos + 16 <= len && !isTokenStart(data[pos])) {
+            __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos));
+            __m128i starts = _mm_setzero_si128();
+            for (const MessageToken& token : kMessageTokens) {
+                starts = _mm_or_si128(starts, _mm_cmpeq_epi8(chunk, _mm_set1_epi8(token.text[0])));
+            }
+            __m128i delimiters = _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('\n')), _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\r'))),
+                _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_setzero_si128()), _mm_cmpeq_epi8(chunk, _mm_set1_epi8(' '))));
+            unsigned startMask = static_cast<unsigned>(_mm_movemask_epi8(starts));
+            unsigned junkMask = ~static_cast<unsigned>(_mm_movemask_epi8(delimiters)) & 0xFFFFu;
+            if (startMask == 0) {
+                result.discarded += __builtin_popcount(junkMask);
+                pos += 16;
+                result.consumed = pos;
+                continue;
+            }
+            unsigned skip = __builtin_ctz(startMask);
+            result.discarded += __builtin_popcount(junkMask & ((1u << skip) - 1));
+            pos += skip;
+        } else if (!isTokenStart(data[pos])) {
+            if (!isMessageDelimiter(data[pos])) result.discarded++; // Tail shorter than a vector
+            pos++;
+            result.consumed = pos;
+            continue;
+        }
+        result.consumed = pos;
+        if (!scanCandidate(data, len, pos, out, maxOut, result)) break;
+    }
+    return result;
+}
+
+/**
+ * @brief AVX2 scanner: finds the next candidate token start 32 bytes at a time.
+ */
+__attribute__((target("avx2,popcnt"))) inline ScanResult scanMessagesAvx2(const char* data, size_t len, MessageType* out, size_t maxOut) {
+    ScanResult result;
+    size_t pos = 0;
+    while (pos < len && result.messages < maxOut) {
+        if (pos + 32 <= len && !isTokenStart(data[pos])) {
+            __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + pos));
+            __m256i starts = _mm256_setzero_si256();
+            for (const MessageToken& token : kMessageTokens) {
+                starts = _mm256_or_si256(starts, _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(token.text[0])));
+            }
+            __m256i delimiters = _mm256_or_si256(
+                _mm256_or_si256(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\n')), _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\r'))),
+                _mm256_or_si256(_mm256_cmpeq_epi8(chunk, _mm256_setzero_si256()), _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(' '))));
+            unsigned startMask = static_cast<unsigned>(_mm256_movemask_epi8(starts));
+            unsigned junkMask = ~static_cast<unsigned>(_mm256_movemask_epi8(delimiters));
+            if (startMask == 0) {
+                result.discarded += __builtin_popcount(junkMask);
+                pos += 32;
+                result.consumed = pos;
+                continue;
+            }
+            unsigned skip = __builtin_ctz(startMask);
+            result.discarded += skip == 0 ? 0 : __builtin_popcount(junkMask & ((1u << skip) - 1));
+            pos += skip;
+        } else if (!isTokenStart(data[pos])) {
+            if (!isMessageDelimiter(data[pos])) result.discarded++;
+            pos++;
+            result.consumed = pos;
+            continue;
+        }
+        result.consumed = pos;
+        if (!scanCandidate(data, len, pos, out, maxOut, result)) break;
+    }
+    return result;
+}
+
+#endif // BURGER_SCANNER_X86
+
+/**
+ * @brief Name of the implementation selectScanner() picks on this CPU.
+ */
+inline const char* scannerName() {
+#ifdef BURGER_SCANNER_X86
+    if (__builtin_cpu_supports("avx2")) return "avx2";
+    if (__builtin_cpu_supports("sse2")) return "sse2";
+#endif
+    return "scalar";
+}
+
+/**
+ * @brief Picks the fastest scanner the CPU supports.
+ */
+inline ScanFunction selectScanner() {
+#ifdef BURGER_SCANNER_X86
+    if (__builtin_cpu_supports("avx2")) return scanMessagesAvx2;
+    if (__builtin_cpu_supports("sse2")) return scanMessagesSse2;
+#endif
+    return scanMessagesScalar;
+}
+
+/**
+ * @brief Classifies every complete message in a buffer with the best scanner.
+ */
+inline ScanResult scanMessages(const char* data, size_t len, MessageType* out, size_t maxOut) {
+    static const ScanFunction scanner = selectScanner();
+    return scanner(data, len, out, maxOut);
+}
+
+#endif // BURGER_SCANNER_H
@@ -0,0 +1,74 @@
+/**
+ * @file seqlock.h
+ * @brief Single-writer sequence lock for publishing small records to many readers.
+ *
+ * The writer bumps a sequence number to odd, stores the record and bumps it back
+ * to even. A reader copies the record between two reads of the sequence and
+ * retries if they differ or were odd. The writer never waits for readers, and
+ * readers never take a lock or write shared memory, so any number of them can
+ * poll without slowing the writer down. The record is held as relaxed atomic
+ * words, so concurrent copies are well defined.
+ *
+ * @author Michael Barry
+ */
+
+#ifndef BURGER_SEQLOCK_H
+#define BURGER_SEQLOCK_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <type_traits>
+
+/**
+ * @brief A record of type T published by one writer to any number of readers.
+ */
+template <typename T>
+class Seqlock {
+    static_assert(std::is_trivially_copyable<T>::value, "records are copied word by word");
+
+public:
+    /**
+     * @brief Publishes a new record. Only one thread may store.
+     */
+    void store(const T& value) {
+        uint64_t buffer[kWords] = {};
+        memcpy(buffer, &value, sizeof(T));
+        uint64_t s = sequence.load(std::memory_order_relaxed);
+        sequence.store(s + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (size_t i = 0; i < kWords; ++i) words[i].store(buffer[i], std::memory_order_relaxed);
+        sequence.store(s + 2, std::memory_order_release);
+    }
+
+    /**
+     * @brief Copies the latest complete record, retrying while a store overlaps the copy.
+     *
+     * Returns a value-initialized record before the first store.
+     */
+    T load() const {
+        uint64_t buffer[kWords];
+        while (true) {
+            uint64_t before = sequence.load(std::memory_order_acquire);
+            if (before & 1) {
+                std::this_thread::yield(); // The writer is mid-store and will finish without us
+                continue;
+            }
+            for (size_t i = 0; i < kWords; ++i) buffer[i] = words[i].load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (sequence.load(std::memory_order_relaxed) == before) break;
+        }
+        T value;
+        memcpy(&value, buffer, sizeof(T));
+        return value;
+    }
+
+private:
+    static constexpr size_t kWords = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+    alignas(64) std::atomic<uint64_t> sequence{0}; // Odd while a store is in progress
+    std::atomic<uint64_t> words[kWords] = {}; // The record, padded to whole words
+};
+
+#endif // BURGER_SEQLOCK_H
@@ -15,26 +15,356 @@
 #include <condition_variable>
 #include <cstdlib>
 #include <cstring>
+#include <string>
+#include <memory>
+#include <chrono>
 #include <unistd.h>
 #include <netinet/in.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <csignal>
 #include <atomic>
 #include <queue>
+#include <deque>
+#include <algorithm>
+#include <random>
+#include <map>
+#include <iomanip>
+#include <new>
+#include <climits>
+#include <cerrno>
+#include <fcntl.h>
+#include <sstream>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <sys/syscall.h>
+#include <sched.h>
+#include <linux/futex.h>
+#include "transport.h"
+#include "message_parser.h"
+#include "chef_profile.h"
+#include "tls.h"
+#include "event_feed.h"
+#include "forecast.h"
+#include "dispatch_policy.h"
+#include "intake_queue.h"
+#include "seqlock.h"
+#include "order_history.h"
 
 using namespace std;
 
 // Function declarations
 void chefFunction(int id);
-void clientHandler(int clientSocket);
+void kitchenDispatcher();
+double kitchenNow();
+void openKitchen(vector<thread>& kitchen);
+void closeKitchen(vector<thread>& kitchen);
+bool openLocalListeners(vector<unique_ptr<Listener>>& listeners);
+bool openNetworkListeners(vector<unique_ptr<Listener>>& listeners, bool reusePort);
+void acceptClients(vector<unique_ptr<Listener>>& listeners);
+int runSupervisor(vector<unique_ptr<Listener>>& listeners);
+int runWorker(int index, vector<unique_ptr<Listener>>& listeners);
+void inventoryWatcher();
+bool mapSharedShop(int fd);
+bool takeOver(Connection& predecessor, vector<unique_ptr<Listener>>& listeners);
+bool handOff(vector<unique_ptr<Listener>>& listeners);
+void inventoryChanged();
+void waitForInventory(uint32_t seen, int timeoutMs);
+void reportServiceStats();
+void checkBooks();
+void adminServer(Listener* adminListener);
+void adminSession(unique_ptr<Connection> connection);
+string runAdminCommand(const string& command);
+bool waitWhilePaused(int timeoutMs);
+void followFeed(Connection& connection);
+void snapshotPublisher();
+void publishEvent(const char* state, const char* item, long id, const string& detail = "");
+void publishEvent(const char* state, const char* item, long first, long last, const string& detail);
+void clientHandler(unique_ptr<Connection> connection);
+struct ClientSession;
+bool processOrder(ClientSession& session, MessageType message, vector<string>& replies);
+void publishOrderEvent(const char* state, const ClientSession& session, long order);
+int currentShard();
+void depositBurgers(int count);
+bool claimBurger(bool& last);
+struct InventoryShard;
+bool takeFromShard(InventoryShard& shard, uint32_t bucket);
+void stockLot(InventoryShard& shard, uint32_t bucket, int count);
+bool expireLot(atomic<uint64_t>& lot, uint32_t bucket);
+void expireStaleBurgers();
+uint32_t freshnessBucket();
+int64_t freshnessBucketNanos();
+int readyBurgers(const InventoryShard& shard);
+int burgersServedTotal();
+void countOrder();
+long ordersTotal();
+bool serveBurgerLocked();
+void burgerServed(bool last);
+void closeShopLocked();
+void fulfillPendingOrdersLocked();
+void refusePendingOrdersLocked();
+void answerLocked(ClientSession& session, MessageType reply);
+int orderPriority(const ClientSession& session);
+void recordOrder(uint64_t client, chrono::steady_clock::time_point placed, OrderOutcome outcome);
+void flushOrderHistory(size_t minimum);
+string historyClientName(uint64_t client);
+struct UdpIntake;
+void udpIngestion(int udpSocket, UdpIntake& intake);
+void udpDispatcher(vector<UdpIntake*> intakes);
+void loopbackBenchClient(atomic<long>& ordersServed);
+void checkInvariant(bool holds, const char* description);
 
 // Global Variables
 mutex mtx; // Mutex for synchronization
-condition_variable cv_burger_ready; // Condition variable for burger availability
-atomic<int> burgersPrepared(0); // Atomic counter for burgers prepared
-atomic<int> burgersServed(0); // Atomic counter for burgers served
 int maxBurgers = 25; // Maximum number of burgers to prepare
 int numChefs = 2; // Number of chef threads
-atomic<bool> serverRunning(true); // Atomic flag to indicate server status
-int server_fd; // Server socket file descriptor
+string unixStreamPath; // Path of the Unix stream socket listener (empty if disabled)
+string unixSeqpacketPath; // Path of the Unix SOCK_SEQPACKET listener (empty if disabled)
+bool udpEnabled = false; // Whether UDP fire-and-forget ingestion is enabled
+int udpThreads = 1; // UDP sockets on the port, each with its own I/O thread
+constexpr int kUdpBatch = 64; // Datagrams per recvmmsg/sendmmsg call
+constexpr size_t kUdpMaxPending = 65536; // UDP orders held while waiting for inventory
+constexpr size_t kUdpIntakeCapacity = 4096; // Orders or acks in flight between one UDP I/O thread and the dispatcher
+
+/**
+ * @brief A decoded UDP order.
+ */
+struct UdpOrder {
+    sockaddr_in from; // Where to send the acknowledgement
+    unsigned long clientId;
+    unsigned long orderId;
+};
+
+/**
+ * @brief The answer to a UDP order.
+ */
+struct UdpAck {
+    UdpOrder order;
+    MessageType status; // BurgerServed or NoMoreBurgers
+};
+
+/**
+ * @brief Orders from one UDP I/O thread to the UDP dispatcher and acks back.
+ */
+struct UdpIntake : IntakeChannel<UdpOrder, UdpAck, kUdpIntakeCapacity> {};
+atomic<bool> udpDispatcherDone(false); // Set once the UDP dispatcher has answered its last order
+atomic<long> udpOrdersShed(0); // UDP orders dropped because an intake queue or the dispatcher's backlog was full
+int loopbackBenchClients = 0; // In-process loopback clients to benchmark with (0 = disabled)
+double timeScale = 1.0; // Multiplier applied to chef preparation times
+size_t maxOutbox = kDefaultSendLimit; // Unread reply bytes a client may accumulate before it is dropped
+const char* kLoopbackName = "burger-shop"; // Name of the in-process loopback listener
+const char* kKitchenItem = "burger"; // The item the kitchen produces
+string chefProfilePath; // File with chef skill profiles (empty = numChefs default chefs)
+int batchSize = 0; // Burgers every chef grills at once (0 = as in the profiles)
+double freshnessSeconds = 0; // Kitchen seconds a ready burger may wait for an order (0 = forever)
+int stockTarget = 0; // Ready and cooking burgers the kitchen keeps at most (0 = cook every burger right away)
+double forecastInterval = 0; // Kitchen seconds per demand forecast step (0 = use the fixed stock target)
+constexpr int kStockPollMs = 10; // How often the dispatcher rechecks stock while waiting for sales or expiry
+vector<ChefProfile> chefProfiles; // Skills and shift of each chef
+string tlsCertPath; // PEM certificate chain for the TLS listener (empty = no TLS)
+string tlsKeyPath; // PEM private key for the TLS listener
+int tlsPort = 54322; // TCP port of the TLS listener
+bool checkInvariants = false; // Whether to verify the shop's bookkeeping as it runs (stress tests)
+atomic<int> invariantViolations(0); // Failed invariant checks
+constexpr int kHandlerWaitMs = 250; // Longest a client handler blocks on the network before rechecking its session
+
+/**
+ * @brief How much the server prints; per-order messages cost time on the hot path.
+ */
+enum LogLevel {
+    kLogWarn, // Problems only
+    kLogInfo, // Also every burger and every client (the default)
+    kLogDebug, // Also every accepted connection and admin command
+};
+const char* const kLogLevelNames[] = {"warn", "info", "debug"};
+atomic<int> logLevel(kLogInfo); // Most detailed level printed; changed live from the admin socket
+
+/**
+ * @brief Whether messages at level are printed.
+ */
+inline bool logging(LogLevel level) {
+    return logLevel.load(memory_order_relaxed) >= level;
+}
+
+/**
+ * @brief A connected client as seen by the pending-order queue, guarded by mtx.
+ *
+ * The admin socket reads the atomic fields through the sessions registry, without mtx.
+ */
+struct ClientSession {
+    Connection* connection = nullptr; // Where queued orders are answered
+    atomic<int> waiting{0}; // Orders of this client in pendingOrders
+    bool slow = false; // Answering a queued order overflowed the client's output buffer
+    bool notified = false; // The client has been told there are no more burgers
+    long id = 0; // Sequence number shown on the admin socket
+    atomic<const char*> kind{""}; // Transport, updated on a shared-memory upgrade
+    chrono::steady_clock::time_point connectedAt; // When the handler started
+    atomic<int> ordersTaken{0}; // Orders read from the client so far
+};
+mutex sessionsMtx; // Guards sessions; never taken together with mtx
+map<long, ClientSession*> sessions; // Live client sessions by id, for the admin socket
+atomic<long> sessionsOpened(0); // Client sessions started, also the last session id
+atomic<int> sessionsLive(0); // Entries in sessions, readable without sessionsMtx
+
+string adminSocketPath; // Unix socket for admin commands (empty = none)
+atomic<bool> adminStopping(false); // Set at shutdown so admin sessions end
+atomic<bool> intakePaused(false); // Admin "pause": no new connections or orders are taken
+mutex intakeMtx; // Guards the wait for intake to resume
+condition_variable cv_intake; // Signals that intake resumed
+atomic<bool> draining(false); // Admin "drain": finish the current clients, then shut down
+EventFeed orderFeed; // Order lifecycle events for kitchen displays
+constexpr size_t kFeedBatch = 256; // Events sent to a display per write
+
+/**
+ * @brief An order received before a burger was ready, guarded by mtx.
+ */
+struct PendingOrder {
+    ClientSession* client; // Who placed it
+    long orderId; // The client's order number, shown on kitchen displays after its session id
+    chrono::steady_clock::time_point placed; // When it arrived
+    int priority; // Class under the priority policy, 0 first
+};
+DispatchQueue<PendingOrder> pendingOrders; // Orders waiting for inventory, in the order the dispatch policy serves them
+atomic<size_t> pendingOrderCount(0); // Size of pendingOrders, read without mtx by the fast path of processOrder
+string dispatchPolicy = "fifo"; // Which waiting order a ready burger goes to
+atomic<long> ordersQueued(0); // Orders that had to wait for inventory
+atomic<long> queuedWaitMicros(0); // Total time those orders waited
+
+constexpr int kInventoryShards = 16; // Stock shards; cores share one when there are more
+constexpr int kFreshnessBuckets = 8; // Cook-time buckets per shard; a burger expires with its whole bucket
+constexpr uint64_t kLotBucket = uint64_t(1) << 32; // Bucket number unit in a lot word
+
+/**
+ * @brief Ready burgers local to the cores that map to one shard, on their own cache lines.
+ *
+ * Stock is a small timer wheel: lots[b % kFreshnessBuckets] holds the burgers
+ * cooked during bucket b, with b in the high 32 bits and the count in the low
+ * 32, so taking, stocking and expiring a lot are each one compare-and-swap.
+ * Orders take from the oldest fresh bucket, and a slot is reused only after its
+ * bucket has expired. Without a freshness window every burger is in bucket 0.
+ */
+struct alignas(64) InventoryShard {
+    atomic<uint64_t> lots[kFreshnessBuckets] = {}; // Ready burgers by cook-time bucket
+    atomic<int> served{0}; // Burgers taken from this shard
+    atomic<int> demand{0}; // Orders that found this shard empty and a chef has not restocked yet
+    atomic<int> orders{0}; // Orders placed on the cores of this shard, for the demand forecast
+};
+
+/**
+ * @brief Shop state that every process of a pre-forked server shares.
+ *
+ * Lives in a memfd mapping in pre-fork mode and while a hot upgrade is possible,
+ * and in localShop otherwise. Only lock-free atomics, so it works across processes.
+ */
+struct SharedShop {
+    alignas(64) atomic<int> burgersPrepared{0}; // Atomic counter for burgers prepared
+    InventoryShard shards[kInventoryShards]; // Ready burgers, spread over cores so orders rarely share a cache line
+    atomic<bool> soldOut{false}; // The last burger was taken; set by the one taker that closes the shop
+    alignas(64) atomic<int> burgersWasted{0}; // Burgers that expired before anyone ordered them
+    int64_t freshnessBucketNs = 0; // Length of a cook-time bucket, fixed before the shop is shared (0 = never expire)
+    alignas(64) atomic<uint32_t> inventorySeq{0}; // Futex word, bumped on every new burger and at closing
+    alignas(64) atomic<int> burgersAssigned{0}; // Burgers handed to a chef so far; one server's dispatcher at a time
+    atomic<bool> serverRunning{true}; // Atomic flag to indicate server status
+};
+static_assert(atomic<int>::is_always_lock_free && atomic<uint32_t>::is_always_lock_free && atomic<uint64_t>::is_always_lock_free &&
+              atomic<bool>::is_always_lock_free,
+              "shared shop counters must be address-free");
+SharedShop localShop; // Shop state of a single-process server
+SharedShop* shop = &localShop; // The shop state in use
+
+/**
+ * @brief Whether the shop takes orders, as the admin socket reports it.
+ */
+enum class ShopState : uint8_t { Open, Paused, Draining, Closed };
+const char* const kShopStateNames[] = {"open", "paused", "draining", "closed"};
+
+/**
+ * @brief The shop's counters as one record, for readers that must never slow the shop down.
+ *
+ * Published through shopSnapshot by the snapshot publisher thread, so admin
+ * commands and kitchen displays read every figure from the same moment without
+ * taking mtx or sessionsMtx.
+ */
+struct ShopSnapshot {
+    uint64_t version; // Bumped whenever a counter changes; 0 before the first snapshot
+    chrono::steady_clock::time_point takenAt; // When the counters were read
+    ShopState state;
+    int maxBurgers;
+    int burgersAssigned; // Handed to chefs, replacements for expired burgers included
+    int burgersPrepared;
+    int burgersServed;
+    int burgersWasted;
+    int shardStock[kInventoryShards]; // Ready burgers per inventory shard
+    long ordersPlaced; // By every process, UDP orders included
+    long ordersWaiting; // Orders in the dispatch queue
+    long ordersQueued; // Orders that had to wait, and their total wait
+    long queuedWaitMicros;
+    int connections;
+    long udpOrdersShed;
+
+    /**
+     * @brief Whether every counter matches; version and takenAt are not counters.
+     *
+     * Compared field by field because the padding bytes memcmp would see are unspecified.
+     */
+    bool sameCounters(const ShopSnapshot& other) const {
+        return state == other.state && maxBurgers == other.maxBurgers && burgersAssigned == other.burgersAssigned &&
+               burgersPrepared == other.burgersPrepared && burgersServed == other.burgersServed &&
+               burgersWasted == other.burgersWasted && equal(begin(shardStock), end(shardStock), begin(other.shardStock)) &&
+               ordersPlaced == other.ordersPlaced && ordersWaiting == other.ordersWaiting && ordersQueued == other.ordersQueued &&
+               queuedWaitMicros == other.queuedWaitMicros && connections == other.connections && udpOrdersShed == other.udpOrdersShed;
+    }
+};
+Seqlock<ShopSnapshot> shopSnapshot; // Latest snapshot, any number of readers
+constexpr int kSnapshotIntervalMs = 5; // How often the publisher looks for changes
+atomic<bool> snapshotStopping(false); // Set at shutdown so the publisher stores a last snapshot and ends
+OrderHistory orderHistory; // Every answered order of every client, for the admin socket
+uint8_t historyItem = orderHistory.itemId(kKitchenItem); // Dictionary id of the kitchen's item
+constexpr uint64_t kUdpHistoryClient = 1ULL << 63; // Marks UDP client ids in orderHistory, apart from session ids
+constexpr size_t kHistoryReplyOrders = 1000; // Most orders one admin history reply lists
+constexpr size_t kHistoryBatch = 64; // Orders a client handler collects before recording them
+
+/**
+ * @brief Orders a thread answered but has not yet added to orderHistory.
+ *
+ * Recording takes a history stripe lock, so it never happens under mtx: orders are
+ * collected here and recorded in a batch by flushOrderHistory() once the thread
+ * is outside the lock. Whatever is left is recorded when the thread exits.
+ */
+struct UnrecordedOrders {
+    vector<HistoryRecord> records;
+    ~UnrecordedOrders() { orderHistory.record(records.data(), records.size()); }
+};
+thread_local UnrecordedOrders unrecordedOrders;
+int sharedShopFd = -1; // memfd holding the shop when other processes map it (-1 = localShop)
+int workerProcesses = 0; // Pre-forked worker processes serving clients (0 = serve in this process)
+string upgradeSocketPath; // Unix socket where a newer server binary takes over (empty = no hot upgrade)
+unique_ptr<Listener> upgradeListener; // Waits for a successor's takeover request
+constexpr int kHandoffTimeoutMs = 5000; // Longest either side of a hot upgrade waits for the other
+bool handedOff = false; // The listeners and kitchen went to a successor; only current clients are left
+bool tookOver = false; // This server carries on a predecessor's shop
+atomic<bool> clientsDone(false); // Every client handler has finished
+#ifdef BURGER_TLS
+shared_ptr<TlsContext> tlsContext; // Certificate for the TLS listener (null = no TLS)
+#endif
+
+/**
+ * @brief Dispatcher-side view of one chef, guarded by kitchenMtx.
+ */
+struct ChefState {
+    bool assigned = false; // Whether the chef has a burger to cook
+    double freeAt = 0; // Expected kitchen time the current burger is done
+    double busySeconds = 0; // Kitchen seconds spent cooking
+    int burgersCooked = 0; // Burgers this chef finished
+    int burger = 0; // Assignment number of the first burger on the grill, for kitchen displays
+    int batch = 0; // Burgers on the grill
+};
+vector<ChefState> chefStates; // One per chef
+mutex kitchenMtx; // Guards chefStates and shop->burgersAssigned
+condition_variable cv_kitchen; // Signals assignments to chefs and completions to the dispatcher
+bool kitchenClosed = false; // Set once no more burgers will be assigned
+chrono::steady_clock::time_point shopOpened; // Kitchen time zero
 
 /**
  * @brief The main function for the burger shop server.
@@ -44,44 +374,385 @@ int server_fd; // Server socket file descriptor
  * @return int Returns 0 on successful execution, 1 otherwise.
  */
 int main(int argc, char* argv[]) {
-    server_fd = socket(AF_INET, SOCK_STREAM, 0);
     sockaddr_in address{};
     address.sin_family = AF_INET;
     address.sin_addr.s_addr = INADDR_ANY;
     address.sin_port = htons(54321);
 
-    // Parse command line arguments
-    if (argc > 1) {
-        if (argc == 3) {
-            maxBurgers = atoi(argv[1]);
-            numChefs = atoi(argv[2]);
+    // Parse command line arguments: two optional positionals followed by options
+    vector<string> positional;
+    bool usageError = false;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--unix" && i + 1 < argc) {
+            unixStreamPath = argv[++i];
+        } else if (arg == "--seqpacket" && i + 1 < argc) {
+            unixSeqpacketPath = argv[++i];
+        } else if (arg == "--udp") {
+            udpEnabled = true;
+        } else if (arg == "--udp-threads" && i + 1 < argc) {
+            udpEnabled = true;
+            udpThreads = atoi(argv[++i]);
+            if (udpThreads < 1) usageError = true;
+        } else if (arg == "--loopback-bench" && i + 1 < argc) {
+            loopbackBenchClients = atoi(argv[++i]);
+        } else if (arg == "--max-outbox" && i + 1 < argc) {
+            maxOutbox = strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "--chefs" && i + 1 < argc) {
+            chefProfilePath = argv[++i];
+        } else if (arg == "--dispatch" && i + 1 < argc) {
+            dispatchPolicy = argv[++i];
+            if (!selectDispatchPolicy(pendingOrders, dispatchPolicy)) usageError = true;
+        } else if (arg == "--batch" && i + 1 < argc) {
+            batchSize = atoi(argv[++i]);
+            if (batchSize < 1) usageError = true;
+        } else if (arg == "--freshness" && i + 1 < argc) {
+            freshnessSeconds = atof(argv[++i]);
+        } else if (arg == "--stock-target" && i + 1 < argc) {
+            stockTarget = atoi(argv[++i]);
+        } else if (arg == "--forecast" && i + 1 < argc) {
+            forecastInterval = atof(argv[++i]);
+        } else if (arg == "--time-scale" && i + 1 < argc) {
+            timeScale = atof(argv[++i]);
+        } else if (arg == "--tls-cert" && i + 1 < argc) {
+            tlsCertPath = argv[++i];
+        } else if (arg == "--tls-key" && i + 1 < argc) {
+            tlsKeyPath = argv[++i];
+        } else if (arg == "--tls-port" && i + 1 < argc) {
+            tlsPort = atoi(argv[++i]);
+        } else if (arg == "--check-invariants") {
+            checkInvariants = true;
+        } else if (arg == "--workers" && i + 1 < argc) {
+            workerProcesses = atoi(argv[++i]);
+        } else if (arg == "--upgrade-socket" && i + 1 < argc) {
+            upgradeSocketPath = argv[++i];
+        } else if (arg == "--admin-socket" && i + 1 < argc) {
+            adminSocketPath = argv[++i];
+        } else if (arg == "--log-level" && i + 1 < argc) {
+            string level = argv[++i];
+            auto known = find(begin(kLogLevelNames), end(kLogLevelNames), level);
+            if (known == end(kLogLevelNames)) usageError = true;
+            logLevel = static_cast<int>(known - begin(kLogLevelNames));
+        } else if (arg.compare(0, 2, "--") == 0) {
+            usageError = true;
         } else {
-            cout << "Usage: " << argv[0] << " <MaxBurgers> <NumChefs>" << endl;
+            positional.push_back(arg);
+        }
+    }
+    // Worker processes and hot upgrades only carry connections; UDP and in-process clients need a single process
+    bool singleProcessOnly = udpEnabled || loopbackBenchClients > 0;
+    bool workerConflict = workerProcesses < 0 ||
+                          (workerProcesses > 0 && (singleProcessOnly || !upgradeSocketPath.empty() || !adminSocketPath.empty())) ||
+                          (!upgradeSocketPath.empty() && singleProcessOnly);
+    // Burgers cannot go stale, nor demand be forecast, on a kitchen clock that stands still
+    bool freshnessConflict = freshnessSeconds < 0 || stockTarget < 0 || forecastInterval < 0 || ((freshnessSeconds > 0 || forecastInterval > 0) && timeScale <= 0) ||
+                             (forecastInterval > 0 && stockTarget > 0);
+    if (usageError || workerConflict || freshnessConflict || (!positional.empty() && positional.size() != 2) ||
+        tlsCertPath.empty() != tlsKeyPath.empty()) {
+        cout << "Usage: " << argv[0] << " <MaxBurgers> <NumChefs> [--unix <Path>] [--seqpacket <Path>] [--udp | --udp-threads <Threads>]"
+             << " [--loopback-bench <Clients>] [--time-scale <Factor>] [--chefs <ProfileFile>] [--batch <Burgers>]"
+             << " [--dispatch fifo|fair|priority|shortest]"
+             << " [--freshness <Seconds>] [--stock-target <Burgers> | --forecast <IntervalSeconds>]"
+             << " [--max-outbox <Bytes>] [--tls-cert <PemFile> --tls-key <PemFile> [--tls-port <Port>]]"
+             << " [--check-invariants] [--workers <Processes> | --upgrade-socket <Path>] [--admin-socket <Path>]"
+             << " [--log-level warn|info|debug]" << endl;
+        return 1;
+    }
+    if (positional.size() == 2) {
+        maxBurgers = atoi(positional[0].c_str());
+        numChefs = atoi(positional[1].c_str());
+    }
+    localShop.freshnessBucketNs = freshnessBucketNanos();
+
+    // Chef skills come from a profile file, or default to identical chefs
+    if (!chefProfilePath.empty()) {
+        string error;
+        chefProfiles = loadChefProfiles(chefProfilePath, error);
+        if (chefProfiles.empty()) {
+            cout << "Invalid chef profiles: " << error << endl;
+            return 1;
+        }
+        numChefs = static_cast<int>(chefProfiles.size());
+    } else {
+        chefProfiles = defaultChefProfiles(numChefs);
+    }
+    if (batchSize > 0) {
+        for (ChefProfile& profile : chefProfiles) profile.batchSize = batchSize;
+    }
+    chefStates.resize(numChefs);
+
+    // Encrypted listener for kiosks; the certificate is checked before opening
+#ifdef BURGER_TLS
+    if (!tlsCertPath.empty()) {
+        string error;
+        tlsContext = TlsContext::server(tlsCertPath, tlsKeyPath, error);
+        if (!tlsContext) {
+            cout << "Invalid TLS certificate or key: " << error << endl;
             return 1;
         }
     }
+#else
+    if (!tlsCertPath.empty()) {
+        cout << "This server was built without TLS support (compile with -DBURGER_TLS)." << endl;
+        return 1;
+    }
+#endif
 
     // Start the server
     cout << "Server listening on port 54321 with " << maxBurgers << " burgers and " << numChefs << " chefs." << endl;
 
-    // Create chef threads
-    vector<thread> chefs;
-    for (int i = 0; i < numChefs; ++i) {
-        chefs.emplace_back(chefFunction, i + 1);
+    // A server already running at the upgrade socket hands over its listeners and shop
+    vector<unique_ptr<Listener>> listeners;
+    unique_ptr<Connection> predecessor;
+    if (!upgradeSocketPath.empty()) predecessor = UnixTransport(SOCK_STREAM, "unix").connect(upgradeSocketPath);
+    if (predecessor) {
+        if (!takeOver(*predecessor, listeners)) return 1;
+    } else {
+        if (!upgradeSocketPath.empty() && !mapSharedShop(-1)) {
+            perror("Shared shop mapping failed");
+            return 1;
+        }
+
+        // Local listeners for co-located callers share the same protocol as TCP; in
+        // pre-fork mode they are opened once and inherited by every worker
+        if (!openLocalListeners(listeners)) return 1;
+        if (workerProcesses > 0) return runSupervisor(listeners);
+
+        // Bind and listen for network client connections
+        if (!openNetworkListeners(listeners, false)) return 1;
+    }
+    if (!upgradeSocketPath.empty()) {
+        upgradeListener = UnixTransport(SOCK_STREAM, "unix", tookOver).listen(upgradeSocketPath); // The predecessor is closing its own
+        if (!upgradeListener) {
+            perror("Upgrade socket bind failed");
+            return 1;
+        }
+        cout << "Accepting hot upgrades on " << upgradeSocketPath << "." << endl;
+    }
+
+    // On-call engineers inspect and steer the running server through the admin socket
+    unique_ptr<Listener> adminListener;
+    thread adminThread;
+    if (!adminSocketPath.empty()) {
+        adminListener = UnixTransport(SOCK_STREAM, "unix", tookOver).listen(adminSocketPath); // Admins reach the newest server
+        if (!adminListener) {
+            perror("Admin socket bind failed");
+            return 1;
+        }
+        cout << "Accepting admin commands on " << adminSocketPath << "." << endl;
+    }
+
+    // Create chef threads and the dispatcher that hands them work
+    vector<thread> kitchen;
+    openKitchen(kitchen);
+    thread snapshotThread(snapshotPublisher);
+    if (adminListener) adminThread = thread(adminServer, adminListener.get());
+
+    // In-process clients measure application throughput without kernel networking
+    thread benchRunner;
+    atomic<long> benchOrdersServed(0);
+    double benchSeconds = 0;
+    if (loopbackBenchClients > 0) {
+        listeners.push_back(LoopbackTransport().listen(kLoopbackName));
+        cout << "Benchmarking with " << loopbackBenchClients << " in-process loopback clients." << endl;
+        benchRunner = thread([&benchOrdersServed, &benchSeconds]() {
+            auto benchStart = chrono::steady_clock::now();
+            vector<thread> benchClients;
+            for (int i = 0; i < loopbackBenchClients; ++i) {
+                benchClients.emplace_back(loopbackBenchClient, ref(benchOrdersServed));
+            }
+            for (auto& benchClient : benchClients) {
+                benchClient.join();
+            }
+            benchSeconds = chrono::duration<double>(chrono::steady_clock::now() - benchStart).count();
+        });
+    }
+
+    // Stateless clients may send orders as UDP datagrams on the same port. With several
+    // I/O threads each has its own SO_REUSEPORT socket, so the kernel spreads clients over them
+    vector<int> udpSockets;
+    vector<unique_ptr<UdpIntake>> udpIntakes;
+    vector<thread> udpIoThreads;
+    thread udpDispatchThread;
+    if (udpEnabled) {
+        int reuse = 1;
+        for (int i = 0; i < udpThreads; ++i) {
+            int udpSocket = socket(AF_INET, SOCK_DGRAM, 0);
+            if (udpSocket < 0 || (udpThreads > 1 && setsockopt(udpSocket, SOL_SOCKET, SO_REUSEPORT, &reuse, sizeof(reuse)) < 0) ||
+                bind(udpSocket, (struct sockaddr*)&address, sizeof(address)) < 0) {
+                perror("UDP socket bind failed");
+                return 1;
+            }
+            udpSockets.push_back(udpSocket);
+            udpIntakes.emplace_back(new UdpIntake());
+        }
+        vector<UdpIntake*> intakes;
+        for (size_t i = 0; i < udpSockets.size(); ++i) {
+            udpIoThreads.emplace_back(udpIngestion, udpSockets[i], ref(*udpIntakes[i]));
+            intakes.push_back(udpIntakes[i].get());
+        }
+        udpDispatchThread = thread(udpDispatcher, intakes);
+        cout << "Server accepting UDP orders on port 54321 with " << udpThreads << " I/O threads." << endl;
+    }
+
+    // Accept and handle client connections until the shop sells out or is handed off. A
+    // server sharing its shop with another binary answers queued orders when that one cooks
+    thread watcher;
+    if (!upgradeSocketPath.empty()) watcher = thread(inventoryWatcher);
+    acceptClients(listeners);
+    clientsDone = true;
+    if (watcher.joinable()) watcher.join();
+    bool drainedEarly = draining && shop->serverRunning;
+    if (drainedEarly) {
+        // Every client has left; close now instead of cooking the rest of the burgers
+        {
+            lock_guard<mutex> lock(kitchenMtx);
+            kitchenClosed = true;
+            cv_kitchen.notify_all();
+        }
+        lock_guard<mutex> lock(mtx);
+        closeShopLocked();
+    }
+
+    if (benchRunner.joinable()) {
+        benchRunner.join();
+        cout << "Loopback benchmark: " << benchOrdersServed << " orders served in " << benchSeconds << " s ("
+             << benchOrdersServed / benchSeconds << " orders/s)." << endl;
+    }
+
+    if (udpDispatchThread.joinable()) udpDispatchThread.join();
+    for (auto& udpIoThread : udpIoThreads) udpIoThread.join();
+    for (int udpSocket : udpSockets) close(udpSocket);
+
+    // Ensure all chefs finish their work
+    closeKitchen(kitchen);
+    if (adminThread.joinable()) {
+        adminStopping = true;
+        adminThread.join();
+        adminListener.reset();
+    }
+    snapshotStopping = true;
+    snapshotThread.join();
+    reportServiceStats();
+    if (handedOff) {
+        // The successor owns the sockets and the rest of the shop now
+        cout << "Served every client of this server. Shutting down after hand-off." << endl;
+        return invariantViolations > 0 ? 2 : 0;
+    }
+    if (drainedEarly) {
+        cout << "Drained with " << burgersServedTotal() << " of " << maxBurgers << " burgers served." << endl;
+    } else {
+        checkBooks();
+    }
+
+    cout << "Customer denied. No more burgers. Server shutting down." << endl;
+    if (!unixStreamPath.empty()) unlink(unixStreamPath.c_str());
+    if (!unixSeqpacketPath.empty()) unlink(unixSeqpacketPath.c_str());
+    if (!upgradeSocketPath.empty()) unlink(upgradeSocketPath.c_str());
+    if (!adminSocketPath.empty()) unlink(adminSocketPath.c_str());
+    return invariantViolations > 0 ? 2 : 0;
+}
+
+/**
+ * @brief Opens the Unix stream and seqpacket listeners that were asked for.
+ *
+ * @param listeners Receives the listeners.
+ * @return false if a socket could not be bound.
+ */
+bool openLocalListeners(vector<unique_ptr<Listener>>& listeners) {
+    if (!unixStreamPath.empty()) {
+        listeners.push_back(UnixTransport(SOCK_STREAM, "unix").listen(unixStreamPath));
+        if (!listeners.back()) {
+            perror("Unix socket bind failed");
+            return false;
+        }
+        cout << "Server listening on Unix socket " << unixStreamPath << "." << endl;
+    }
+    if (!unixSeqpacketPath.empty()) {
+        listeners.push_back(UnixTransport(SOCK_SEQPACKET, "seqpacket").listen(unixSeqpacketPath));
+        if (!listeners.back()) {
+            perror("Unix seqpacket socket bind failed");
+            return false;
+        }
+        cout << "Server listening on Unix seqpacket socket " << unixSeqpacketPath << "." << endl;
     }
+    return true;
+}
 
-    // Bind and listen for client connections
-    bind(server_fd, (struct sockaddr*)&address, sizeof(address));
-    listen(server_fd, 10);
+/**
+ * @brief Opens the TCP listener and, if configured, the TLS listener.
+ *
+ * @param listeners Receives the listeners.
+ * @param reusePort Whether other worker processes listen on the same ports.
+ * @return false if a socket could not be bound.
+ */
+bool openNetworkListeners(vector<unique_ptr<Listener>>& listeners, bool reusePort) {
+    listeners.push_back(TcpTransport(reusePort).listen(":54321"));
+    if (!listeners.back()) {
+        perror("TCP bind failed");
+        return false;
+    }
+#ifdef BURGER_TLS
+    if (tlsContext) {
+        signal(SIGPIPE, SIG_IGN); // OpenSSL writes with write(), which has no MSG_NOSIGNAL
+        listeners.push_back(TlsTransport(tlsContext, reusePort).listen(":" + to_string(tlsPort)));
+        if (!listeners.back()) {
+            perror("TLS bind failed");
+            return false;
+        }
+        if (!reusePort) cout << "Server listening for TLS on port " << tlsPort << "." << endl;
+    }
+#endif
+    return true;
+}
 
-    // Accept and handle client connections
+/**
+ * @brief Accepts connections until the shop sells out, then waits for their handlers.
+ *
+ * @param listeners The listeners to accept from.
+ */
+void acceptClients(vector<unique_ptr<Listener>>& listeners) {
+    vector<pollfd> pollFds;
+    for (auto& listener : listeners) {
+        pollFds.push_back({listener->pollFd(), POLLIN, 0});
+    }
+    if (upgradeListener) pollFds.push_back({upgradeListener->pollFd(), POLLIN, 0});
     vector<thread> clientThreads;
-    while (serverRunning) {
-        int clientSocket = accept(server_fd, nullptr, nullptr);
-        if (clientSocket >= 0) {
-            clientThreads.emplace_back(clientHandler, clientSocket);
+    while (shop->serverRunning && !handedOff && !draining) {
+        if (waitWhilePaused(500)) continue; // New connections wait in the backlog
+
+        // Poll with a timeout so the loop notices when the shop closes
+        if (poll(pollFds.data(), pollFds.size(), 500) <= 0) continue;
+        for (size_t i = 0; i < listeners.size(); ++i) {
+            if (!(pollFds[i].revents & POLLIN)) continue;
+            unique_ptr<Connection> connection = listeners[i]->accept(); // nullptr if another worker took it
+            if (connection) {
+                if (logging(kLogDebug)) cout << "Accepted a " << connection->kind() << " client." << endl;
+                connection->setSendLimit(maxOutbox);
+                clientThreads.emplace_back(clientHandler, move(connection));
+            }
+        }
+        if (upgradeListener && (pollFds.back().revents & POLLIN)) handOff(listeners);
+    }
+    if (upgradeListener) pollFds.pop_back();
+
+    // Connections already queued in the backlog would be reset when the listeners
+    // close; accept them so their orders are answered "No more burgers". A drain
+    // refuses them instead: the shop is still open, and they would keep it open.
+    while (!handedOff && !draining && poll(pollFds.data(), pollFds.size(), 0) > 0) {
+        bool accepted = false;
+        for (size_t i = 0; i < pollFds.size(); ++i) {
+            if (!(pollFds[i].revents & POLLIN)) continue;
+            unique_ptr<Connection> connection = listeners[i]->accept();
+            if (connection) {
+                accepted = true;
+                connection->setSendLimit(maxOutbox);
+                clientThreads.emplace_back(clientHandler, move(connection));
+            }
         }
+        if (!accepted) break;
     }
+    listeners.clear(); // Refuse later connections instead of leaving them in a backlog nobody accepts from
 
     // Wait for all client threads to finish
     for (auto& clientThread : clientThreads) {
@@ -89,83 +760,1504 @@ int main(int argc, char* argv[]) {
             clientThread.join();
         }
     }
+}
 
-    // Ensure all chefs finish their work
-    for (auto& chef : chefs) {
-        if (chef.joinable()) {
-            chef.join();
+/**
+ * @brief Runs the pre-forked server: a supervisor process and workerProcesses workers.
+ *
+ * The shop counters move to a shared mapping before forking. The supervisor runs
+ * the kitchen and watches the workers; each worker accepts connections on its own
+ * SO_REUSEPORT TCP (and TLS) listener and on the shared Unix listeners, and claims
+ * burgers from the shared counters without locks. A worker that crashes while the
+ * shop is open is replaced. Orders queued in a crashed worker are lost with it.
+ *
+ * @param listeners Local listeners every worker inherits.
+ * @return int The server's exit status.
+ */
+int runSupervisor(vector<unique_ptr<Listener>>& listeners) {
+    if (!mapSharedShop(-1)) {
+        perror("Shared shop mapping failed");
+        return 1;
+    }
+
+    // Workers race for connections on shared listeners; the losers must not block in accept
+    for (auto& listener : listeners) {
+        fcntl(listener->pollFd(), F_SETFL, fcntl(listener->pollFd(), F_GETFL) | O_NONBLOCK);
+    }
+
+    map<pid_t, int> workers; // Live worker processes and their indices
+    auto spawnWorker = [&workers, &listeners](int index) {
+        pid_t pid = fork();
+        if (pid < 0) {
+            perror("Worker fork failed");
+            return false;
+        }
+        if (pid == 0) _exit(runWorker(index, listeners)); // Skip the supervisor's destructors and atexit handlers
+        workers[pid] = index;
+        return true;
+    };
+    for (int i = 0; i < workerProcesses; ++i) {
+        if (!spawnWorker(i)) {
+            shop->serverRunning = false; // Lets the workers already started wind down
+            break;
+        }
+    }
+    cout << "Started " << workers.size() << " worker processes." << endl;
+
+    // The kitchen starts after the first fork so no worker inherits its threads
+    vector<thread> kitchen;
+    openKitchen(kitchen);
+
+    int respawns = 0;
+    int failedWorkers = 0;
+    while (!workers.empty()) {
+        int status;
+        pid_t pid = waitpid(-1, &status, 0);
+        if (pid < 0) {
+            if (errno == EINTR) continue;
+            break;
         }
+        auto worker = workers.find(pid);
+        if (worker == workers.end()) continue;
+        int index = worker->second;
+        workers.erase(worker);
+        if (WIFEXITED(status)) {
+            if (WEXITSTATUS(status) == 2) invariantViolations++; // The worker already printed what went wrong
+            if (WEXITSTATUS(status) == 1) failedWorkers++;
+            continue;
+        }
+        cout << "Worker " << index << " (pid " << pid << ") was killed by signal " << WTERMSIG(status) << "." << endl;
+        if (shop->serverRunning && spawnWorker(index)) respawns++;
     }
+    if (respawns > 0) cout << "Replaced " << respawns << " crashed worker processes." << endl;
+
+    // Without workers nobody claims the rest of the burgers; the kitchen still finishes its batch
+    shop->serverRunning = false;
+    closeKitchen(kitchen);
+    checkBooks();
 
     cout << "Customer denied. No more burgers. Server shutting down." << endl;
-    close(server_fd); // Close the server socket
-    return 0;
+    listeners.clear(); // Close the server sockets
+    if (!unixStreamPath.empty()) unlink(unixStreamPath.c_str());
+    if (!unixSeqpacketPath.empty()) unlink(unixSeqpacketPath.c_str());
+    if (failedWorkers > 0) return 1;
+    return invariantViolations > 0 ? 2 : 0;
 }
 
 /**
- * @brief Function executed by each chef thread.
+ * @brief Body of one worker process of the pre-forked server.
  *
- * This function simulates a chef preparing burgers. It generates a random
- * preparation time for each burger and notifies the server when a burger is ready.
+ * Serves clients exactly like the single-process server. Burgers come from the
+ * supervisor's kitchen, so the chefs' wake-ups arrive through the inventoryWatcher
+ * thread instead of the chefs answering queued orders themselves.
  *
- * @param id The ID of the chef thread.
+ * @param index The worker's number, for the log.
+ * @param listeners The inherited local listeners; the worker adds its network listeners.
+ * @return int The worker's exit status: 1 if it could not listen, 2 on invariant violations.
  */
-void chefFunction(int id) {
+int runWorker(int index, vector<unique_ptr<Listener>>& listeners) {
+    invariantViolations = 0; // A replacement worker starts with its own tally
+    if (!openNetworkListeners(listeners, true)) return 1;
+    cout << "Worker " << index << " (pid " << getpid() << ") accepting clients." << endl;
+
+    thread watcher(inventoryWatcher);
+    thread snapshotThread(snapshotPublisher); // For this worker's kitchen displays
+    acceptClients(listeners);
+    watcher.join();
+    snapshotStopping = true;
+    snapshotThread.join();
+    reportServiceStats();
+    return invariantViolations > 0 ? 2 : 0;
+}
+
+/**
+ * @brief Function executed by the inventory watcher thread of a process sharing the shop.
+ *
+ * Sleeps on the shared inventory futex and answers this process's queued orders
+ * whenever a chef in another process (the supervisor, or the other server binary
+ * during a hot upgrade) finishes a burger, and refuses them once the shop closes.
+ */
+void inventoryWatcher() {
     while (true) {
-        int preparationTime = (rand() % 2 == 0) ? 2 : 4; // Random preparation time of 2 or 4 seconds
+        uint32_t seen = shop->inventorySeq; // Read before looking, so no wake-up is missed
         {
-            unique_lock<mutex> lock(mtx);
-            if (burgersPrepared >= maxBurgers) break;
-            burgersPrepared++;
-            cout << "Chef " << id << " prepared burger #" << burgersPrepared << " in " << preparationTime << " seconds. " << (maxBurgers - burgersPrepared) << " burgers left to prepare." << endl;
+            lock_guard<mutex> lock(mtx);
+            if (!shop->serverRunning) {
+                refusePendingOrdersLocked(); // Another process sold the last burger
+                break;
+            }
+            if (clientsDone) break; // Handed off, and nobody is left to answer
+            fulfillPendingOrdersLocked();
         }
-        cv_burger_ready.notify_all(); // Notify all waiting on this condition
-        this_thread::sleep_for(chrono::seconds(preparationTime)); // Simulate preparation time
+        flushOrderHistory(0);
+        waitForInventory(seen, kHandlerWaitMs);
     }
 }
 
 /**
- * @brief Function to handle client requests.
+ * @brief Tells every process that inventory or the shop's status changed.
+ */
+void inventoryChanged() {
+    shop->inventorySeq++;
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&shop->inventorySeq), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+}
+
+/**
+ * @brief Sleeps until inventoryChanged() is called or timeoutMs passes.
  *
- * This function is executed for each client connection. It receives orders from clients,
- * serves burgers if available, and handles client disconnections.
+ * @param seen The inventory sequence number the caller last acted on.
+ * @param timeoutMs Longest time to sleep.
+ */
+void waitForInventory(uint32_t seen, int timeoutMs) {
+    timespec timeout{timeoutMs / 1000, (timeoutMs % 1000) * 1000000L};
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&shop->inventorySeq), FUTEX_WAIT, seen, &timeout, nullptr, 0);
+}
+
+/**
+ * @brief Moves the shop counters into a memfd mapping other processes can share.
  *
- * @param clientSocket The client socket file descriptor.
+ * @param fd A predecessor's shop memfd to adopt, or -1 to create a fresh shop.
+ * @return false if the memory could not be mapped.
  */
-void clientHandler(int clientSocket) {
-    char orderBuffer[1024];
-    int ordersProcessed = 0;
+bool mapSharedShop(int fd) {
+    bool created = fd < 0;
+    if (created) {
+        fd = memfd_create("burger-shop", MFD_CLOEXEC);
+        if (fd < 0) return false;
+        if (ftruncate(fd, sizeof(SharedShop)) < 0) {
+            close(fd);
+            return false;
+        }
+    }
+    void* mapping = mmap(nullptr, sizeof(SharedShop), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mapping == MAP_FAILED) {
+        close(fd);
+        return false;
+    }
+    shop = created ? new (mapping) SharedShop() : static_cast<SharedShop*>(mapping);
+    if (created) shop->freshnessBucketNs = freshnessBucketNanos();
+    sharedShopFd = fd;
+    return true;
+}
 
-    while (serverRunning && ordersProcessed < maxBurgers) {
-        memset(orderBuffer, 0, sizeof(orderBuffer)); // Clear the buffer
-        int bytesReceived = recv(clientSocket, orderBuffer, sizeof(orderBuffer), 0); // Wait for order
+/**
+ * @brief Takes over the listeners and shop of the server running at upgradeSocketPath.
+ *
+ * Asks for a hand-off, receives the shop memfd and every listening socket with
+ * SCM_RIGHTS, confirms, and waits until the predecessor's dispatcher has stopped
+ * so only this server's kitchen assigns burgers from then on. The predecessor
+ * keeps serving the clients it already has.
+ *
+ * @param predecessor Connection to the running server's upgrade socket.
+ * @param listeners Receives the inherited listeners.
+ * @return false if the hand-off failed; the predecessor then keeps running.
+ */
+bool takeOver(Connection& predecessor, vector<unique_ptr<Listener>>& listeners) {
+    char buffer[256] = {0};
+    int fds[kMaxPassedFds];
+    int fdCount = 0;
+    pollfd ready{predecessor.socketFd(), POLLIN, 0};
+    int bytesReceived = 0;
+    if (!Message<ControlType::Takeover>::send(predecessor) || poll(&ready, 1, kHandoffTimeoutMs) <= 0 ||
+        (bytesReceived = ShmEndpoint::recvWithFds(predecessor.socketFd(), buffer, sizeof(buffer) - 1, fds, fdCount)) <= 0 ||
+        !Message<ControlType::Handoff>::prefixOf(buffer, bytesReceived) || fdCount < 1) {
+        for (int i = 0; i < fdCount; ++i) close(fds[i]);
+        cout << "The server at " << upgradeSocketPath << " did not hand over its shop." << endl;
+        return false;
+    }
 
-        if (bytesReceived <= 0) {
-            if (bytesReceived == 0) {
-                cout << "Client disconnected. Order Done." << endl;
-            } else {
-                cout << "Error occurred in receiving. Stopping handler." << endl;
-            }
-            break; // Exit if error in receiving or client disconnected
+    // "Handoff <MaxBurgers> <Kind>..." describes the descriptors after the shop's memfd
+    istringstream handoff(buffer + Message<ControlType::Handoff>::length);
+    handoff >> maxBurgers;
+    vector<string> kinds;
+    for (string kind; handoff >> kind;) kinds.push_back(kind);
+    if (static_cast<int>(kinds.size()) != fdCount - 1 || !mapSharedShop(fds[0])) {
+        for (int i = 0; i < fdCount; ++i) close(fds[i]);
+        cout << "Invalid hand-off from the server at " << upgradeSocketPath << "." << endl;
+        return false;
+    }
+    for (size_t i = 0; i < kinds.size(); ++i) {
+        int fd = fds[i + 1];
+        if (kinds[i] == "tcp") {
+            listeners.emplace_back(new SocketListener(fd, "tcp", true));
+        } else if (kinds[i] == "unix") {
+            listeners.emplace_back(new SocketListener(fd, "unix", false));
+        } else if (kinds[i] == "seqpacket") {
+            listeners.emplace_back(new SocketListener(fd, "seqpacket", false));
+#ifdef BURGER_TLS
+        } else if (kinds[i] == "tls" && tlsContext) {
+            signal(SIGPIPE, SIG_IGN); // OpenSSL writes with write(), which has no MSG_NOSIGNAL
+            listeners.emplace_back(new TlsListener(unique_ptr<Listener>(new SocketListener(fd, "tcp", true)), tlsContext));
+#endif
+        } else {
+            cout << "Dropping the inherited " << kinds[i] << " listener this server cannot serve." << endl;
+            close(fd);
         }
+    }
 
-        unique_lock<mutex> lock(mtx);
-        if (strcmp(orderBuffer, "Order") == 0 && burgersPrepared > burgersServed) {
-            burgersServed++;
-            send(clientSocket, "Burger Served", strlen("Burger Served"), 0);
-            cout << "Served burger #" << burgersServed << " to client." << endl;
-            ordersProcessed++;
-            if (burgersServed >= maxBurgers) {
-                serverRunning = false; // Stop the server once all burgers are served
-                cv_burger_ready.notify_all(); // Wake up any waiting clients
-                cout << "No more burgers to serve. Accepting no more customers (Press 'CTRL + C' to exit)" << endl;
-                send(clientSocket, "No more burgers", strlen("No more burgers"), 0); // Notify the last client
-                break; // Break out of the loop to end the client session
-            }
-        } else {
-            cv_burger_ready.wait(lock); // Wait for a burger to be ready
+    bytesReceived = Message<ControlType::TakeoverAccepted>::send(predecessor) ? predecessor.recv(buffer, sizeof(buffer) - 1, kHandoffTimeoutMs) : -1;
+    if (bytesReceived <= 0 || !Message<ControlType::KitchenClosed>::prefixOf(buffer, bytesReceived)) {
+        cout << "The server at " << upgradeSocketPath << " did not close its kitchen." << endl;
+        return false;
+    }
+    tookOver = true;
+    cout << "Took over the running server's shop: " << burgersServedTotal() << " of " << maxBurgers << " burgers served, "
+         << listeners.size() << " listeners inherited." << endl;
+    return true;
+}
+
+/**
+ * @brief Hands the listeners and kitchen to a newer server binary asking on the upgrade socket.
+ *
+ * Accepting stops afterwards, but the listening sockets stay open in the successor,
+ * so no connection attempt is refused. Clients already connected here are served
+ * to the end of their sessions from the shared shop.
+ *
+ * @param listeners The listeners to pass on.
+ * @return true if the successor took over.
+ */
+bool handOff(vector<unique_ptr<Listener>>& listeners) {
+    unique_ptr<Connection> successor = upgradeListener->accept();
+    if (!successor) return false;
+    char buffer[64] = {0};
+    int bytesReceived = successor->recv(buffer, sizeof(buffer) - 1, kHandoffTimeoutMs);
+    if (bytesReceived <= 0 || !Message<ControlType::Takeover>::prefixOf(buffer, bytesReceived)) return false;
+
+    if (1 + listeners.size() > static_cast<size_t>(kMaxPassedFds)) {
+        // Handing over only some listeners would leave the rest unserved; the successor gives up and this server carries on
+        cout << "Cannot hand over " << listeners.size() << " listeners, at most " << kMaxPassedFds - 1
+             << " fit in one hand-off. Refusing the upgrade." << endl;
+        return false;
+    }
+    string handoff = Message<ControlType::Handoff>::str() + to_string(maxBurgers);
+    int fds[kMaxPassedFds] = {sharedShopFd};
+    int fdCount = 1;
+    for (auto& listener : listeners) {
+        handoff += string(" ") + listener->kind();
+        fds[fdCount++] = listener->pollFd();
+    }
+    if (!ShmEndpoint::sendWithFds(successor->socketFd(), handoff.data(), handoff.size(), fds, fdCount)) return false;
+    memset(buffer, 0, sizeof(buffer));
+    bytesReceived = successor->recv(buffer, sizeof(buffer) - 1, kHandoffTimeoutMs);
+    if (bytesReceived <= 0 || !Message<ControlType::TakeoverAccepted>::prefixOf(buffer, bytesReceived)) {
+        cout << "A new server asked to take over but gave up. Carrying on." << endl;
+        return false;
+    }
+
+    // Only one dispatcher may assign burgers; the chefs here finish what they have
+    {
+        lock_guard<mutex> lock(kitchenMtx);
+        kitchenClosed = true;
+        cv_kitchen.notify_all();
+    }
+    Message<ControlType::KitchenClosed>::send(*successor);
+    successor->flush(1000);
+    upgradeListener.reset(); // The successor binds the upgrade socket next
+    handedOff = true;
+    cout << "Handed the shop over to a new server. Finishing the current clients." << endl;
+    return true;
+}
+
+/**
+ * @brief Prints how long handshakes and queued orders took in this process.
+ */
+void reportServiceStats() {
+#ifdef BURGER_TLS
+    // Handshake cost, split by whether the client resumed a session ticket
+    TlsStats& tls = tlsStats();
+    if (tls.fullHandshakes + tls.resumedHandshakes + tls.failedHandshakes > 0) {
+        cout << "TLS handshakes: " << tls.fullHandshakes << " full";
+        if (tls.fullHandshakes > 0) cout << " (mean " << tls.fullMicros / 1000.0 / tls.fullHandshakes << " ms)";
+        cout << ", " << tls.resumedHandshakes << " resumed";
+        if (tls.resumedHandshakes > 0) cout << " (mean " << tls.resumedMicros / 1000.0 / tls.resumedHandshakes << " ms)";
+        cout << ", " << tls.failedHandshakes << " failed." << endl;
+    }
+#endif
+
+    if (ordersQueued > 0) {
+        cout << ordersQueued << " orders waited for a burger, " << queuedWaitMicros / 1000.0 / ordersQueued << " ms on average." << endl;
+    }
+    if (udpOrdersShed > 0) cout << udpOrdersShed << " UDP orders shed because the server could not keep up." << endl;
+}
+
+/**
+ * @brief Checks at closing that the kitchen's books balance, if --check-invariants is on.
+ *
+ * The shop only closes once every burger is served, so the books must balance.
+ */
+void checkBooks() {
+    if (!checkInvariants) return;
+    int cooked = 0;
+    for (const ChefState& chef : chefStates) cooked += chef.burgersCooked;
+    checkInvariant(burgersServedTotal() == maxBurgers, "shop closed before every burger was served");
+    checkInvariant(shop->burgersPrepared - shop->burgersWasted == maxBurgers, "kitchen did not prepare exactly MaxBurgers fresh burgers");
+    if (tookOver) {
+        checkInvariant(cooked <= shop->burgersPrepared, "chef tallies exceed burgers prepared"); // The predecessor cooked the rest
+    } else {
+        checkInvariant(cooked == shop->burgersPrepared, "chef tallies do not add up to burgers prepared");
+    }
+    cout << "Invariant checks: " << invariantViolations << " violations." << endl;
+}
+
+/**
+ * @brief Returns the kitchen clock: seconds since opening, in unscaled chef time.
+ *
+ * With --time-scale 0 the kitchen clock stands still at opening time.
+ */
+double kitchenNow() {
+    if (timeScale <= 0) return 0;
+    return chrono::duration<double>(chrono::steady_clock::now() - shopOpened).count() / timeScale;
+}
+
+/**
+ * @brief Starts the chef threads and the dispatcher that hands them work.
+ *
+ * @param kitchen Receives the threads.
+ */
+void openKitchen(vector<thread>& kitchen) {
+    shopOpened = chrono::steady_clock::now();
+    for (int i = 0; i < numChefs; ++i) {
+        kitchen.emplace_back(chefFunction, i);
+    }
+    kitchen.emplace_back(kitchenDispatcher);
+}
+
+/**
+ * @brief Waits for the kitchen to finish and prints per-chef utilization.
+ *
+ * @param kitchen The threads started by openKitchen().
+ */
+void closeKitchen(vector<thread>& kitchen) {
+    for (auto& cook : kitchen) {
+        if (cook.joinable()) {
+            cook.join();
+        }
+    }
+
+    // Per-chef utilization over the time each chef was on shift
+    double closedAt = kitchenNow();
+    for (int i = 0; i < numChefs; ++i) {
+        const ChefProfile& profile = chefProfiles[i];
+        double shift = max(0.0, min(profile.shiftEnd, closedAt) - profile.shiftStart);
+        cout << profile.name << ": " << chefStates[i].burgersCooked << " burgers, busy " << chefStates[i].busySeconds << " s";
+        if (shift > 0) cout << " (" << static_cast<int>(100 * min(1.0, chefStates[i].busySeconds / shift)) << "% utilization)";
+        cout << "." << endl;
+    }
+    if (shop->freshnessBucketNs > 0) {
+        int prepared = shop->burgersPrepared;
+        cout << shop->burgersWasted << " of " << prepared << " burgers expired before anyone ordered them ("
+             << (prepared > 0 ? 100.0 * shop->burgersWasted / prepared : 0.0) << "% waste)." << endl;
+    }
+}
+
+/**
+ * @brief Function executed by the kitchen dispatcher thread.
+ *
+ * Hands burgers to chefs a grill load at a time, always to the chef expected to
+ * finish first given their skill, current work and shift. When that chef is busy or not
+ * yet on shift, the burger waits for them instead of going to a slower idle chef.
+ *
+ * Expired burgers are replaced, and with a stock target the kitchen only cooks
+ * while ready and cooking burgers are below it, so output follows sales. With
+ * --forecast the target follows the order rate forecast over a chef's lead time,
+ * plus the orders already waiting.
+ */
+void kitchenDispatcher() {
+    unique_lock<mutex> lock(kitchenMtx);
+    vector<double> freeAt(numChefs);
+    DemandForecaster forecaster(forecastInterval > 0 ? forecastInterval : 1);
+    double leadTime = 0; // Mean seconds from starting a grill load to having it ready
+    for (const ChefProfile& profile : chefProfiles) leadTime += profile.meanPrep / chefProfiles.size();
+    while (!kitchenClosed) { // Closed early when handing off
+        expireStaleBurgers();
+        int wasted = shop->burgersWasted;
+        int remaining = maxBurgers - (shop->burgersAssigned - wasted); // Fresh burgers still to cook
+        int allowed = remaining;
+        int target = stockTarget;
+        if (forecastInterval > 0) {
+            long orders = ordersTotal();
+            forecaster.observe(kitchenNow(), orders);
+            long waiting = max(0L, orders - burgersServedTotal()); // Already owed, on top of what the forecast expects
+            target = forecaster.stockTarget(leadTime, freshnessSeconds) + static_cast<int>(waiting);
+        }
+        if (target > 0) allowed = min(allowed, target - (shop->burgersAssigned - burgersServedTotal() - wasted));
+        if (allowed <= 0) {
+            // Done, unless burgers may still expire and need replacing or sales free up room under the target
+            if (!shop->serverRunning || (remaining <= 0 && shop->freshnessBucketNs == 0)) break;
+            cv_kitchen.wait_for(lock, chrono::milliseconds(kStockPollMs));
+            continue;
+        }
+
+        double now = kitchenNow();
+        for (int i = 0; i < numChefs; ++i) {
+            freeAt[i] = chefStates[i].assigned ? chefStates[i].freeAt : now;
+        }
+        int best = chooseChef(chefProfiles, freeAt, now, kKitchenItem);
+        if (best < 0) {
+            cout << "No chef on shift can make any more burgers." << endl;
+            break;
+        }
+        const ChefProfile& profile = chefProfiles[best];
+        if (!chefStates[best].assigned && profile.onShift(now)) {
+            chefStates[best].assigned = true;
+            chefStates[best].freeAt = now + profile.meanPrep;
+            chefStates[best].burger = shop->burgersAssigned + 1;
+            chefStates[best].batch = min(profile.batchSize, allowed);
+            shop->burgersAssigned += chefStates[best].batch;
+            cv_kitchen.notify_all();
+            continue;
         }
+
+        // Wait for the chosen chef to free up or start their shift
+        double wakeAt = max(freeAt[best], profile.shiftStart);
+        auto wait = chrono::duration<double>(max(0.001, (wakeAt - now) * timeScale));
+        if (shop->freshnessBucketNs > 0) wait = min<chrono::duration<double>>(wait, chrono::milliseconds(kStockPollMs));
+        cv_kitchen.wait_for(lock, min<chrono::duration<double>>(wait, chrono::seconds(1)));
     }
+    kitchenClosed = true;
+    cv_kitchen.notify_all();
+}
+
+/**
+ * @brief Function executed by each chef thread.
+ *
+ * This function simulates a chef preparing burgers. It waits for the dispatcher to
+ * assign a grill load, cooks it for one time drawn from the chef's profile and
+ * stocks the whole load with one update and one wake-up.
+ *
+ * @param id The index of the chef.
+ */
+void chefFunction(int id) {
+    const ChefProfile& profile = chefProfiles[id];
+    mt19937 rng(random_device{}()); // Per-chef generator; rand() is not thread-safe
+    while (true) {
+        int burger;
+        int count;
+        {
+            unique_lock<mutex> lock(kitchenMtx);
+            cv_kitchen.wait(lock, [id] { return chefStates[id].assigned || kitchenClosed; });
+            if (!chefStates[id].assigned) break;
+            burger = chefStates[id].burger;
+            count = chefStates[id].batch;
+        }
+        publishEvent("cooking", "burger", burger, burger + count - 1, profile.name);
+
+        double preparationTime = profile.samplePrep(rng);
+        this_thread::sleep_for(chrono::duration<double>(preparationTime * timeScale)); // Simulate preparation time
+        {
+            // A supervisor's chef never takes mtx: a worker forked meanwhile would inherit it locked
+            unique_lock<mutex> lock(mtx, defer_lock);
+            if (workerProcesses == 0) lock.lock();
+            int prepared = shop->burgersPrepared += count; // Before they are stocked, so nothing is served before it was prepared
+            if (checkInvariants) checkInvariant(prepared - shop->burgersWasted <= maxBurgers, "prepared more than MaxBurgers fresh burgers");
+            depositBurgers(count);
+            if (logging(kLogInfo)) {
+                cout << profile.name << " prepared burger" << (count > 1 ? "s #" + to_string(prepared - count + 1) + "-" : " #")
+                     << prepared << " in " << preparationTime << " seconds. " << (maxBurgers - prepared) << " burgers left to prepare." << endl;
+            }
+            publishEvent("ready", "burger", burger, burger + count - 1, profile.name); // Before they are served to waiting orders
+            if (lock.owns_lock()) fulfillPendingOrdersLocked(); // The oldest waiting orders get the burgers right away
+        }
+        flushOrderHistory(0);
+        if (sharedShopFd >= 0) inventoryChanged(); // Other processes answer their own queued orders
 
-    close(clientSocket); // Close the client socket
-}
\ No newline at end of file
+        unique_lock<mutex> lock(kitchenMtx);
+        chefStates[id].assigned = false;
+        chefStates[id].busySeconds += preparationTime;
+        chefStates[id].burgersCooked += count;
+        cv_kitchen.notify_all(); // Let the dispatcher hand out the next burger
+    }
+}
+
+/**
+ * @brief Function to handle client requests.
+ *
+ * This function is executed for each client connection. It receives orders from clients,
+ * serves burgers if available, and handles client disconnections. Orders that arrive
+ * before a burger is ready wait in the shop's pending-order queue and are answered by
+ * the chef who finishes the next burger, so the handler keeps reading the connection
+ * meanwhile and never waits on the kitchen itself. A client on a Unix stream socket
+ * may first ask for a shared-memory channel, after which the same loop serves orders
+ * from the ring.
+ *
+ * @param connection The client connection, on any transport.
+ */
+void clientHandler(unique_ptr<Connection> connection) {
+    MessageParser parser; // Per-connection receive ring; one read may hold many orders
+    ClientSession session;
+    session.connection = connection.get();
+    session.kind = connection->kind();
+    session.connectedAt = chrono::steady_clock::now();
+    {
+        lock_guard<mutex> lock(sessionsMtx);
+        session.id = ++sessionsOpened;
+        sessions[session.id] = &session;
+        sessionsLive++;
+    }
+    int ordersProcessed = 0;
+    vector<string> replies;
+    bool clientGone = false;
+    char ignored[256]; // Receives what the client sends past the order cap
+
+    while (true) {
+        // A client cannot use more than every burger; orders past that are read and
+        // ignored until the ones still queued for it have been answered
+        bool capReached = ordersProcessed >= maxBurgers;
+        if (capReached && session.waiting == 0) break;
+        size_t space = sizeof(ignored);
+        char* receiveInto = capReached ? ignored : parser.writeSpan(space);
+        int bytesReceived = kRecvTimedOut; // While intake is paused, orders stay unread in the socket
+        if (!waitWhilePaused(kHandlerWaitMs)) {
+            bytesReceived = connection->recv(receiveInto, space, kHandlerWaitMs); // Wait for orders, but not forever
+        }
+
+        if (bytesReceived == kRecvTimedOut) {
+            flushOrderHistory(0); // The client is idle, so record what it has ordered
+            // Queued orders are answered by the chefs; check on them and on the shop
+            lock_guard<mutex> lock(mtx);
+            if (session.slow) {
+                if (logging(kLogWarn)) cout << "Client is not reading its replies. Disconnecting." << endl;
+                clientGone = true;
+                break;
+            }
+            if (!shop->serverRunning) break;
+            continue;
+        }
+        if (bytesReceived <= 0) {
+            if (bytesReceived == 0) {
+                if (logging(kLogInfo)) cout << "Client disconnected. Order Done." << endl;
+            } else {
+                if (logging(kLogWarn)) cout << "Error occurred in receiving. Stopping handler." << endl;
+            }
+            clientGone = true;
+            break; // Exit if error in receiving or client disconnected
+        }
+        if (capReached) continue;
+        parser.commit(bytesReceived);
+
+        // Serve every complete message, a batch at a time
+        MessageType batch[64];
+        size_t batchSize;
+        bool sessionOver = false;
+        while (!sessionOver && ordersProcessed < maxBurgers && (batchSize = parser.nextBatch(batch, 64)) > 0) {
+            for (size_t i = 0; i < batchSize && !sessionOver && ordersProcessed < maxBurgers; ++i) {
+                MessageType message = batch[i];
+                if (message == MessageType::ShmRing) {
+                    bool onlyMessage = batchSize == 1 && parser.available() == 0;
+                    if (ordersProcessed == 0 && onlyMessage && strcmp(connection->kind(), "unix") == 0) {
+                        connection = ShmConnection::upgrade(static_cast<SocketConnection&>(*connection));
+                        if (!connection) {
+                            if (logging(kLogWarn)) cout << "Failed to set up shared-memory channel. Stopping handler." << endl;
+                            sessionOver = clientGone = true;
+                            break;
+                        }
+                        connection->setSendLimit(maxOutbox);
+                        session.kind = connection->kind();
+                        lock_guard<mutex> lock(mtx);
+                        session.connection = connection.get();
+                    } else {
+                        // Answer anyway, so the client does not wait for descriptors that never come
+                        Message<ControlType::ShmRingRefused>::send(*connection);
+                    }
+                    continue;
+                }
+                if (message == MessageType::KitchenDisplay) {
+                    if (ordersProcessed == 0) {
+                        followFeed(*connection); // The connection becomes a display for the rest of its life
+                        sessionOver = clientGone = true;
+                    }
+                    continue;
+                }
+                if (message != MessageType::Order) continue;
+
+                replies.clear();
+                sessionOver = processOrder(session, message, replies);
+                bool keptUp = true;
+                for (const string& reply : replies) {
+                    keptUp = connection->send(reply.data(), reply.size()) && keptUp; // Never blocks
+                }
+                if (!keptUp) {
+                    // Slow-consumer policy: buffer up to maxOutbox, then drop the client
+                    if (logging(kLogWarn)) cout << "Client is not reading its replies. Disconnecting." << endl;
+                    sessionOver = clientGone = true;
+                }
+                ordersProcessed++;
+                session.ordersTaken = ordersProcessed;
+            }
+        }
+        flushOrderHistory(kHistoryBatch);
+        if (sessionOver) break; // End the client session once the shop is out of burgers
+    }
+
+    {
+        // Orders still queued for this client can no longer be answered; a client that
+        // is still listening hears that the shop closed
+        lock_guard<mutex> lock(mtx);
+        visit([&session](auto& orders) {
+            orders.removeIf([&session](const PendingOrder& order) { return order.client == &session; });
+            pendingOrderCount = orders.size();
+        }, pendingOrders);
+        session.connection = nullptr;
+        if (!shop->serverRunning && !session.notified && !clientGone) {
+            Message<MessageType::NoMoreBurgers>::send(*connection);
+        }
+    }
+    flushOrderHistory(0);
+    {
+        lock_guard<mutex> lock(sessionsMtx);
+        sessions.erase(session.id);
+        sessionsLive--;
+    }
+    if (!clientGone) connection->closeGracefully(1000); // Give the last replies a moment to reach the client
+}
+
+/**
+ * @brief Streams order lifecycle events to a kitchen display until it leaves or the shop closes.
+ *
+ * The display shares the feed's event buffers and reads at its own pace. A display
+ * that falls a whole feed ring behind, or whose unread events overflow the output
+ * buffer, is disconnected rather than slowing anyone else down.
+ *
+ * @param connection The display's connection.
+ */
+void followFeed(Connection& connection) {
+    uint64_t cursor = orderFeed.subscribe();
+    if (logging(kLogInfo)) cout << "Kitchen display connected." << endl;
+
+    // Events only describe changes, so a new display starts from the current picture
+    ShopSnapshot snapshot = shopSnapshot.load();
+    int ready = 0;
+    for (int stock : snapshot.shardStock) ready += stock;
+    string status = "Shop " + to_string(snapshot.version) + " " + kShopStateNames[static_cast<int>(snapshot.state)] + " served " +
+                    to_string(snapshot.burgersServed) + "/" + to_string(snapshot.maxBurgers) + " ready " + to_string(ready) +
+                    " waiting " + to_string(snapshot.ordersWaiting) + "\n";
+    connection.send(status.data(), status.size());
+    vector<EventFeed::Event> events;
+    string batch;
+    char ignored[256];
+    while (true) {
+        orderFeed.wait(cursor, kHandlerWaitMs);
+        bool shopOpen = shop->serverRunning && !draining; // Read first, so every event up to closing is sent
+        if (!orderFeed.read(cursor, events, kFeedBatch)) {
+            if (logging(kLogWarn)) cout << "Kitchen display fell behind the feed. Disconnecting." << endl;
+            break;
+        }
+        batch.clear();
+        for (const EventFeed::Event& event : events) batch += *event;
+        if (!batch.empty() && !connection.send(batch.data(), batch.size())) {
+            if (logging(kLogWarn)) cout << "Kitchen display is not reading its events. Disconnecting." << endl;
+            break;
+        }
+        if (events.size() == kFeedBatch) continue; // More are waiting
+        if (!shopOpen) {
+            string closed = Message<MessageType::NoMoreBurgers>::str() + "\n";
+            connection.send(closed.data(), closed.size());
+            connection.flush(1000);
+            break;
+        }
+        // Lingering batches the next events and notices a display that left
+        int bytesReceived = connection.recv(ignored, sizeof(ignored), events.empty() ? 0 : kFeedLingerMs);
+        if (bytesReceived != kRecvTimedOut && bytesReceived <= 0) break;
+    }
+    orderFeed.unsubscribe();
+}
+
+/**
+ * @brief Publishes an order lifecycle event to kitchen displays, if any are watching.
+ *
+ * @param state What happened: queued, cooking, ready, served or refused.
+ * @param item "burger", or "order" for an event without a client session.
+ * @param id Burger assignment number, or order number.
+ * @param detail Extra text at the end of the event, e.g. the chef's name.
+ */
+void publishEvent(const char* state, const char* item, long id, const string& detail) {
+    publishEvent(state, item, id, id, detail);
+}
+
+/**
+ * @brief Publishes one event for a range of burgers, e.g. "ready burger 5-8 Chef 1" for a grill load.
+ */
+void publishEvent(const char* state, const char* item, long first, long last, const string& detail) {
+    if (!orderFeed.hasSubscribers()) return;
+    string text = string(state) + " " + item + " " + to_string(first);
+    if (last > first) text += "-" + to_string(last);
+    if (!detail.empty()) text += " " + detail;
+    orderFeed.publish(text);
+}
+
+/**
+ * @brief Publishes an event for a client's order, numbered <Session>.<Order>, e.g. "served order 7.3".
+ */
+void publishOrderEvent(const char* state, const ClientSession& session, long order) {
+    if (!orderFeed.hasSubscribers()) return;
+    orderFeed.publish(string(state) + " order " + to_string(session.id) + "." + to_string(order));
+}
+
+/**
+ * @brief Function executed by each in-process benchmark client.
+ *
+ * Orders over the loopback transport one burger at a time until the shop runs out.
+ *
+ * @param ordersServed Counter of burgers served to all benchmark clients.
+ */
+void loopbackBenchClient(atomic<long>& ordersServed) {
+    unique_ptr<Connection> connection = LoopbackTransport().connect(kLoopbackName);
+    if (!connection) return;
+
+    char buffer[1024];
+    while (Message<MessageType::Order>::send(*connection)) {
+        int bytesReceived = connection->recv(buffer, sizeof(buffer));
+        if (bytesReceived <= 0 || !Message<MessageType::BurgerServed>::prefixOf(buffer, bytesReceived)) break;
+        ordersServed++;
+    }
+}
+
+/**
+ * @brief Takes one order from a client.
+ *
+ * If a burger is ready and nobody is waiting ahead, the burger is served and the
+ * replies for the client are appended to replies. While nobody is waiting the
+ * burger comes from this core's inventory shard without taking mtx. Otherwise the order joins the
+ * pending-order queue and is answered by fulfillPendingOrdersLocked() once a chef
+ * finishes a burger, or with "No more burgers" if the shop sells out first.
+ *
+ * @param session The client placing the order.
+ * @param message The message received from the client.
+ * @param replies Receives the messages to send back to the client right away.
+ * @return true if the client session should end because the shop is out of burgers.
+ */
+bool processOrder(ClientSession& session, MessageType message, vector<string>& replies) {
+    if (message != MessageType::Order) return false;
+    long orderId = session.ordersTaken + 1; // Numbered per session, so no counter is shared between handlers
+    countOrder();
+    auto placed = chrono::steady_clock::now();
+    unique_lock<mutex> lock(mtx, defer_lock);
+    bool last = false;
+    // Nobody is waiting, so take a burger from this core's stock without the shop lock
+    bool served = pendingOrderCount == 0 && shop->serverRunning && claimBurger(last);
+    if (!served) {
+        lock.lock();
+        if (!shop->serverRunning) {
+            replies.push_back(Message<MessageType::NoMoreBurgers>::str()); // The shop closed while this order was in flight
+            session.notified = true;
+            publishOrderEvent("refused", session, orderId);
+            recordOrder(session.id, placed, OrderOutcome::Refused);
+            return true;
+        }
+        served = pendingOrderCount == 0 && claimBurger(last); // Again under mtx, which chefs stock under
+        if (!served) {
+            PendingOrder order{&session, orderId, placed, orderPriority(session)};
+            visit([&order](auto& orders) {
+                orders.push(order);
+                pendingOrderCount = orders.size();
+            }, pendingOrders);
+            session.waiting++;
+            publishOrderEvent("queued", session, orderId);
+            return false;
+        }
+    }
+    replies.push_back(Message<MessageType::BurgerServed>::str());
+    publishOrderEvent("served", session, orderId);
+    recordOrder(session.id, placed, OrderOutcome::Served);
+    if (!last) {
+        burgerServed(false);
+        return false;
+    }
+    if (!lock.owns_lock()) lock.lock();
+    burgerServed(true);
+    replies.push_back(Message<MessageType::NoMoreBurgers>::str()); // Notify the last client
+    session.notified = true;
+    return true;
+}
+
+/**
+ * @brief Sends a reply to a queued order's client. The caller must hold mtx.
+ */
+void answerLocked(ClientSession& session, MessageType reply) {
+    const MessageToken& token = messageToken(reply);
+    if (!session.connection->send(token.text, token.length)) session.slow = true; // The handler disconnects it
+}
+
+/**
+ * @brief Collects an answered order for its client's history, timed from when the shop opened.
+ *
+ * Safe under mtx; the order reaches orderHistory at the thread's next flushOrderHistory().
+ * @param client A session id, or a UDP client id marked with kUdpHistoryClient.
+ */
+void recordOrder(uint64_t client, chrono::steady_clock::time_point placed, OrderOutcome outcome) {
+    unrecordedOrders.records.push_back({client, chrono::duration_cast<chrono::microseconds>(placed - shopOpened).count(), historyItem, outcome});
+}
+
+/**
+ * @brief Records the orders this thread has collected. The caller must not hold mtx.
+ *
+ * @param minimum Leave them collected until there are at least this many, to record in bigger batches.
+ */
+void flushOrderHistory(size_t minimum) {
+    vector<HistoryRecord>& records = unrecordedOrders.records;
+    if (records.empty() || records.size() < minimum) return;
+    orderHistory.record(records.data(), records.size());
+    records.clear();
+}
+
+/**
+ * @brief How the admin socket names a client in the order history: its session id, or udp:ClientId.
+ */
+string historyClientName(uint64_t client) {
+    return client & kUdpHistoryClient ? "udp:" + to_string(client & ~kUdpHistoryClient) : to_string(client);
+}
+
+/**
+ * @brief The priority class of a client's orders: co-located clients first, network clients second.
+ */
+int orderPriority(const ClientSession& session) {
+    const char* kind = session.kind;
+    return strcmp(kind, "tcp") == 0 || strcmp(kind, "tls") == 0 ? 1 : 0;
+}
+
+/**
+ * @brief Serves ready burgers to waiting orders in dispatch-policy order. The caller must hold mtx.
+ *
+ * Called whenever a chef finishes a burger, so a queued order waits exactly as long
+ * as the kitchen needs and not for the client's next message. The loop is
+ * instantiated for each policy, so picking the next order is inlined.
+ */
+void fulfillPendingOrdersLocked() {
+    visit([](auto& orders) {
+        bool last = false;
+        while (!orders.empty() && shop->serverRunning && claimBurger(last)) {
+            PendingOrder order = orders.pop();
+            pendingOrderCount = orders.size();
+            order.client->waiting--;
+            ordersQueued++;
+            queuedWaitMicros += chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - order.placed).count();
+            answerLocked(*order.client, MessageType::BurgerServed); // Before closing, which may refuse this client's later orders
+            publishOrderEvent("served", *order.client, order.orderId);
+            recordOrder(order.client->id, order.placed, OrderOutcome::Served);
+            burgerServed(last);
+            if (last) {
+                answerLocked(*order.client, MessageType::NoMoreBurgers); // Notify the last client
+                order.client->notified = true;
+            }
+        }
+    }, pendingOrders);
+}
+
+/**
+ * @brief Answers every waiting order "No more burgers". The caller must hold mtx.
+ */
+void refusePendingOrdersLocked() {
+    visit([](auto& orders) {
+        orders.drain([](const PendingOrder& order) {
+            order.client->waiting--;
+            answerLocked(*order.client, MessageType::NoMoreBurgers);
+            order.client->notified = true;
+            publishOrderEvent("refused", *order.client, order.orderId);
+            recordOrder(order.client->id, order.placed, OrderOutcome::Refused);
+        });
+    }, pendingOrders);
+    pendingOrderCount = 0;
+}
+
+/**
+ * @brief The inventory shard of the core the calling thread runs on.
+ */
+int currentShard() {
+    int cpu = sched_getcpu();
+    return cpu < 0 ? 0 : cpu % kInventoryShards;
+}
+
+/**
+ * @brief Stocks prepared burgers where orders are going unserved, with one atomic update.
+ *
+ * They go to the shard with the most orders that found it empty, or to the chef's
+ * own core's shard when no shard is short.
+ *
+ * @param count Burgers to stock, e.g. a whole grill load.
+ */
+void depositBurgers(int count) {
+    InventoryShard* target = &shop->shards[currentShard()];
+    int most = 0;
+    for (InventoryShard& shard : shop->shards) {
+        int demand = shard.demand.load(memory_order_relaxed);
+        if (demand > most) {
+            most = demand;
+            target = &shard;
+        }
+    }
+    while (most > 0 && !target->demand.compare_exchange_weak(most, max(0, most - count), memory_order_relaxed)) {
+    }
+    stockLot(*target, freshnessBucket(), count);
+}
+
+/**
+ * @brief Adds burgers cooked in bucket to the shard's lot for that bucket.
+ *
+ * The slot's previous lot is older than the freshness window when its bucket
+ * differs, so whatever is left of it is written off as waste.
+ */
+void stockLot(InventoryShard& shard, uint32_t bucket, int count) {
+    atomic<uint64_t>& lot = shard.lots[bucket % kFreshnessBuckets];
+    uint64_t word = lot.load();
+    uint64_t stocked;
+    do {
+        // A lot stamped by a clock read a moment later than ours is just as fresh
+        bool current = static_cast<int32_t>(static_cast<uint32_t>(word / kLotBucket) - bucket) >= 0;
+        stocked = current ? word + count : uint64_t(bucket) * kLotBucket + count;
+    } while (!lot.compare_exchange_weak(word, stocked));
+    if (static_cast<uint32_t>(stocked / kLotBucket) != static_cast<uint32_t>(word / kLotBucket)) {
+        shop->burgersWasted += static_cast<uint32_t>(word);
+    }
+}
+
+/**
+ * @brief Writes off a lot if its bucket is older than the freshness window.
+ *
+ * @param bucket The current bucket.
+ * @return true if the lot is expired (and now empty).
+ */
+bool expireLot(atomic<uint64_t>& lot, uint32_t bucket) {
+    uint64_t word = lot.load();
+    while (static_cast<int32_t>(bucket - static_cast<uint32_t>(word / kLotBucket)) >= kFreshnessBuckets) {
+        if (static_cast<uint32_t>(word) == 0) return true;
+        if (lot.compare_exchange_weak(word, word / kLotBucket * kLotBucket)) {
+            shop->burgersWasted += static_cast<uint32_t>(word);
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Writes off every expired lot, so waste is counted and replaced even without orders.
+ */
+void expireStaleBurgers() {
+    if (shop->freshnessBucketNs == 0) return;
+    uint32_t bucket = freshnessBucket();
+    for (InventoryShard& shard : shop->shards) {
+        for (atomic<uint64_t>& lot : shard.lots) expireLot(lot, bucket);
+    }
+}
+
+/**
+ * @brief The current cook-time bucket, on the monotonic clock every process shares.
+ */
+uint32_t freshnessBucket() {
+    int64_t width = shop->freshnessBucketNs;
+    if (width == 0) return 0;
+    return static_cast<uint32_t>(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count() / width);
+}
+
+/**
+ * @brief Bucket length for --freshness: the window spans kFreshnessBuckets buckets.
+ *
+ * A lot expires once its newest burger could be older than the window, so no
+ * burger is served stale and none is thrown out more than one bucket early.
+ */
+int64_t freshnessBucketNanos() {
+    if (freshnessSeconds <= 0) return 0;
+    return max<int64_t>(1, static_cast<int64_t>(freshnessSeconds * timeScale * 1e9 / kFreshnessBuckets));
+}
+
+/**
+ * @brief Takes one ready burger, from this core's shard if it has one and from another otherwise.
+ *
+ * Lock-free, so worker processes can claim from the same inventory. An order on
+ * a core whose shard is empty raises that shard's demand for the chefs.
+ *
+ * @param last Set to whether this was the last burger the shop had; exactly one
+ *        taker sees it, and it must close the shop.
+ * @return true if a burger was taken.
+ */
+bool claimBurger(bool& last) {
+    int home = currentShard();
+    uint32_t bucket = freshnessBucket();
+    for (int i = 0; i < kInventoryShards; ++i) {
+        InventoryShard& shard = shop->shards[(home + i) % kInventoryShards];
+        if (takeFromShard(shard, bucket)) {
+            // Only once the kitchen has cooked enough fresh burgers can the shop run out
+            int wasted = shop->burgersWasted;
+            last = shop->burgersPrepared - wasted >= maxBurgers && burgersServedTotal() == maxBurgers && !shop->soldOut.exchange(true);
+            return true;
+        }
+        if (i == 0) shard.demand.fetch_add(1, memory_order_relaxed); // Stolen or not, this core ran short
+    }
+    return false;
+}
+
+/**
+ * @brief Takes the oldest fresh burger from one shard, writing off expired lots on the way.
+ *
+ * @param bucket The current cook-time bucket.
+ * @return true if a burger was taken.
+ */
+bool takeFromShard(InventoryShard& shard, uint32_t bucket) {
+    int buckets = shop->freshnessBucketNs > 0 ? kFreshnessBuckets : 1;
+    for (int age = buckets - 1; age >= 0; --age) {
+        uint32_t wanted = bucket - age;
+        atomic<uint64_t>& lot = shard.lots[wanted % kFreshnessBuckets];
+        uint64_t word = lot.load();
+        while (static_cast<uint32_t>(word) > 0) {
+            if (static_cast<uint32_t>(word / kLotBucket) != wanted) {
+                expireLot(lot, bucket); // Or a lot stocked a moment after our clock read, left for the next order
+                break;
+            }
+            if (lot.compare_exchange_weak(word, word - 1)) {
+                shard.served++; // After the take, so the last one counted sees every burger served
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Burgers taken from every shard so far.
+ */
+int burgersServedTotal() {
+    int served = 0;
+    for (const InventoryShard& shard : shop->shards) served += shard.served;
+    return served;
+}
+
+/**
+ * @brief Counts a placed order on this core's shard, so worker processes add to the same total.
+ */
+void countOrder() {
+    shop->shards[currentShard()].orders.fetch_add(1, memory_order_relaxed);
+}
+
+/**
+ * @brief Orders placed since the shop opened, across all processes.
+ */
+long ordersTotal() {
+    long orders = 0;
+    for (const InventoryShard& shard : shop->shards) orders += shard.orders.load(memory_order_relaxed);
+    return orders;
+}
+
+/**
+ * @brief Ready burgers in one shard, expired lots included until they are written off.
+ */
+int readyBurgers(const InventoryShard& shard) {
+    int ready = 0;
+    for (const atomic<uint64_t>& lot : shard.lots) ready += static_cast<uint32_t>(lot.load());
+    return ready;
+}
+
+/**
+ * @brief Serves one ready burger if there is one.
+ *
+ * Closes the shop once the last burger is served. The caller must hold mtx.
+ *
+ * @return true if a burger was served.
+ */
+bool serveBurgerLocked() {
+    bool last = false;
+    if (!claimBurger(last)) return false;
+    burgerServed(last);
+    return true;
+}
+
+/**
+ * @brief Logs a claimed burger and closes the shop after the last one.
+ *
+ * @param last What claimBurger() reported; the caller must hold mtx if it is set.
+ */
+void burgerServed(bool last) {
+    if (checkInvariants) checkInvariant(burgersServedTotal() <= shop->burgersPrepared, "served a burger that was never prepared");
+    if (logging(kLogInfo)) cout << "Served burger #" << burgersServedTotal() << " to client." << endl;
+    if (last) closeShopLocked(); // Stop the server once all burgers are served
+}
+
+/**
+ * @brief Closes the shop in every process. The caller must hold mtx.
+ */
+void closeShopLocked() {
+    shop->serverRunning = false;
+    refusePendingOrdersLocked(); // Nobody waits for a burger that will never come
+    inventoryChanged(); // Other workers refuse their own waiting orders
+    cout << "No more burgers to serve. Accepting no more customers (Press 'CTRL + C' to exit)" << endl;
+}
+
+/**
+ * @brief Function executed by each UDP I/O thread.
+ *
+ * Receives "Order <ClientId> <OrderId>" datagrams in batches with recvmmsg, decodes
+ * them and hands them to the UDP dispatcher through the thread's intake channel,
+ * then sends the acknowledgements the dispatcher hands back in batches with
+ * sendmmsg ("Burger Served <ClientId> <OrderId>" or "No more burgers <ClientId> <OrderId>").
+ * Never takes mtx. No per-client state is kept beyond the pending orders themselves.
+ *
+ * @param udpSocket The bound UDP socket file descriptor.
+ * @param intake This thread's queues to and from the dispatcher.
+ */
+void udpIngestion(int udpSocket, UdpIntake& intake) {
+    char inBuffers[kUdpBatch][128];
+    sockaddr_in inAddrs[kUdpBatch];
+    iovec inIov[kUdpBatch];
+    mmsghdr inMsgs[kUdpBatch];
+    UdpOrder decoded[kUdpBatch];
+
+    char outBuffers[kUdpBatch][128];
+    sockaddr_in outAddrs[kUdpBatch];
+    iovec outIov[kUdpBatch];
+    mmsghdr outMsgs[kUdpBatch];
+    UdpAck acks[kUdpBatch];
+
+    // Runs until the dispatcher has answered its last order, then sends what is left
+    while (true) {
+        bool dispatcherDone = udpDispatcherDone;
+        int count = static_cast<int>(intake.replies.drain(acks, kUdpBatch));
+        for (int i = 0; i < count; ++i) {
+            const UdpOrder& order = acks[i].order;
+            int len = snprintf(outBuffers[i], sizeof(outBuffers[i]), "%s %lu %lu", messageToken(acks[i].status).text, order.clientId, order.orderId);
+            outAddrs[i] = order.from;
+            outIov[i] = {outBuffers[i], static_cast<size_t>(len)};
+            outMsgs[i] = {};
+            outMsgs[i].msg_hdr.msg_name = &outAddrs[i];
+            outMsgs[i].msg_hdr.msg_namelen = sizeof(outAddrs[i]);
+            outMsgs[i].msg_hdr.msg_iov = &outIov[i];
+            outMsgs[i].msg_hdr.msg_iovlen = 1;
+        }
+        for (int sent = 0; sent < count;) {
+            int batch = sendmmsg(udpSocket, outMsgs + sent, count - sent, 0);
+            if (batch <= 0) break; // Fire-and-forget: lost acks are not retried
+            sent += batch;
+        }
+        if (count == kUdpBatch) continue; // More acks are waiting
+        if (dispatcherDone) break;
+
+        // Sleep until a datagram or an acknowledgement arrives
+        pollfd fds[2] = {{udpSocket, POLLIN, 0}, {intake.replies.wakeFd(), POLLIN, 0}};
+        poll(fds, 2, !intake.replies.prepareToSleep() ? 0 : shop->serverRunning ? 500 : 20);
+        intake.replies.wokeUp();
+
+        for (int i = 0; i < kUdpBatch; ++i) {
+            inIov[i] = {inBuffers[i], sizeof(inBuffers[i]) - 1};
+            inMsgs[i] = {};
+            inMsgs[i].msg_hdr.msg_name = &inAddrs[i];
+            inMsgs[i].msg_hdr.msg_namelen = sizeof(inAddrs[i]);
+            inMsgs[i].msg_hdr.msg_iov = &inIov[i];
+            inMsgs[i].msg_hdr.msg_iovlen = 1;
+        }
+        int received = recvmmsg(udpSocket, inMsgs, kUdpBatch, MSG_DONTWAIT, nullptr);
+        size_t orders = 0;
+        for (int i = 0; i < received; ++i) {
+            inBuffers[i][inMsgs[i].msg_len] = '\0';
+            UdpOrder& order = decoded[orders];
+            order.from = inAddrs[i];
+            if (!Message<MessageType::Order>::prefixOf(inBuffers[i], inMsgs[i].msg_len) ||
+                sscanf(inBuffers[i] + Message<MessageType::Order>::length, " %lu %lu", &order.clientId, &order.orderId) != 2) {
+                continue;
+            }
+            orders++;
+        }
+        udpOrdersShed += orders - intake.requests.push(decoded, orders); // Shed what does not fit
+    }
+}
+
+/**
+ * @brief Function executed by the UDP dispatcher thread.
+ *
+ * Drains the orders of every UDP I/O thread in batches, keeps them pending until
+ * inventory is available, serves as many as it can in one critical section and
+ * hands the acknowledgements back to the thread that received each order.
+ *
+ * @param intakes The intake channel of each UDP I/O thread.
+ */
+void udpDispatcher(vector<UdpIntake*> intakes) {
+    struct Pending {
+        UdpOrder order;
+        UdpIntake* intake; // Where the acknowledgement goes
+        chrono::steady_clock::time_point placed; // When the dispatcher took it, for the order history
+    };
+    deque<Pending> pending;
+    UdpOrder batch[kUdpBatch];
+    vector<pollfd> fds(intakes.size());
+    auto acknowledge = [](const Pending& entry, MessageType status) {
+        UdpAck ack{entry.order, status};
+        while (!entry.intake->replies.push(ack)) this_thread::yield(); // The I/O thread keeps draining until we are done
+        recordOrder(kUdpHistoryClient | entry.order.clientId, entry.placed,
+                    status == MessageType::BurgerServed ? OrderOutcome::Served : OrderOutcome::Refused);
+    };
+
+    // Keep answering for a short linger period after the shop closes so orders already
+    // in flight get a "No more burgers" instead of silence
+    auto closedAt = chrono::steady_clock::time_point::max();
+    while (shop->serverRunning || chrono::steady_clock::now() - closedAt < chrono::milliseconds(200)) {
+        for (UdpIntake* intake : intakes) {
+            size_t count;
+            while ((count = intake->requests.drain(batch, kUdpBatch)) > 0) {
+                auto now = chrono::steady_clock::now();
+                for (size_t i = 0; i < count; ++i) {
+                    if (pending.size() >= kUdpMaxPending) {
+                        udpOrdersShed++; // Shed load beyond the limit
+                        continue;
+                    }
+                    pending.push_back({batch[i], intake, now});
+                    countOrder(); // Only orders that will be answered count as demand
+                }
+            }
+        }
+
+        // Serve as many pending orders as inventory allows in one critical section
+        size_t served = 0;
+        {
+            unique_lock<mutex> lock(mtx);
+            while (served < pending.size() && serveBurgerLocked()) {
+                served++;
+            }
+        }
+        for (size_t i = 0; i < served; ++i) {
+            acknowledge(pending.front(), MessageType::BurgerServed);
+            pending.pop_front();
+        }
+        if (!shop->serverRunning) {
+            if (closedAt == chrono::steady_clock::time_point::max()) closedAt = chrono::steady_clock::now();
+            for (const Pending& entry : pending) {
+                acknowledge(entry, MessageType::NoMoreBurgers);
+            }
+            pending.clear();
+        }
+
+        flushOrderHistory(0);
+
+        // Sleep until an I/O thread hands over orders; poll briefly while orders wait for inventory
+        bool idle = true;
+        for (size_t i = 0; i < intakes.size(); ++i) {
+            idle = intakes[i]->requests.prepareToSleep() && idle;
+            fds[i] = {intakes[i]->requests.wakeFd(), POLLIN, 0};
+        }
+        poll(fds.data(), fds.size(), !idle ? 0 : (pending.empty() && shop->serverRunning) ? 500 : 20);
+        for (UdpIntake* intake : intakes) intake->requests.wokeUp();
+    }
+    udpDispatcherDone = true;
+}
+
+/**
+ * @brief Function executed by the snapshot publisher thread.
+ *
+ * Reads the shop's counters every kSnapshotIntervalMs and publishes them as a
+ * new snapshot version when any has changed. The only writer of shopSnapshot,
+ * and it only reads the counters, so the serving path pays nothing for it.
+ */
+void snapshotPublisher() {
+    ShopSnapshot published{};
+    while (true) {
+        bool stopping = snapshotStopping; // Read first, so the last snapshot follows every change
+        ShopSnapshot current{};
+        current.state = !shop->serverRunning ? ShopState::Closed : draining ? ShopState::Draining
+                        : intakePaused ? ShopState::Paused : ShopState::Open;
+        current.maxBurgers = maxBurgers;
+        current.burgersAssigned = shop->burgersAssigned;
+        current.burgersPrepared = shop->burgersPrepared;
+        current.burgersWasted = shop->burgersWasted;
+        for (int i = 0; i < kInventoryShards; ++i) current.shardStock[i] = readyBurgers(shop->shards[i]);
+        current.burgersServed = burgersServedTotal();
+        current.ordersPlaced = ordersTotal();
+        current.ordersWaiting = pendingOrderCount;
+        current.ordersQueued = ordersQueued;
+        current.queuedWaitMicros = queuedWaitMicros;
+        current.connections = sessionsLive;
+        current.udpOrdersShed = udpOrdersShed;
+
+        if (published.version == 0 || !current.sameCounters(published)) {
+            current.version = published.version + 1;
+            current.takenAt = chrono::steady_clock::now();
+            shopSnapshot.store(current);
+            published = current;
+        }
+        if (stopping) break;
+        this_thread::sleep_for(chrono::milliseconds(kSnapshotIntervalMs));
+    }
+}
+
+/**
+ * @brief Function executed by the admin thread.
+ *
+ * Accepts admin connections on the admin socket and gives each its own session
+ * thread, so an idle interactive session never holds up another.
+ *
+ * @param adminListener The bound admin socket.
+ */
+void adminServer(Listener* adminListener) {
+    vector<thread> adminSessions;
+    pollfd fd{adminListener->pollFd(), POLLIN, 0};
+    while (!adminStopping) {
+        if (poll(&fd, 1, kHandlerWaitMs) <= 0) continue;
+        unique_ptr<Connection> connection = adminListener->accept();
+        if (connection) adminSessions.emplace_back(adminSession, move(connection));
+    }
+    for (auto& adminSessionThread : adminSessions) {
+        adminSessionThread.join();
+    }
+}
+
+/**
+ * @brief Answers one admin connection's commands, one per line, until it disconnects.
+ *
+ * @param connection The admin connection.
+ */
+void adminSession(unique_ptr<Connection> connection) {
+    connection->setSendLimit(1 << 24); // A connection listing can be long
+    string pending;
+    char buffer[1024];
+    while (!adminStopping) {
+        int bytesReceived = connection->recv(buffer, sizeof(buffer), kHandlerWaitMs);
+        if (bytesReceived == kRecvTimedOut) continue;
+        if (bytesReceived <= 0) break;
+        pending.append(buffer, bytesReceived);
+        size_t newline;
+        while ((newline = pending.find('\n')) != string::npos) {
+            string command = pending.substr(0, newline);
+            pending.erase(0, newline + 1);
+            if (!command.empty() && command.back() == '\r') command.pop_back();
+            if (command.empty()) continue;
+            if (logging(kLogDebug)) cout << "Admin command: " << command << endl;
+            string reply = runAdminCommand(command);
+            if (!connection->send(reply.data(), reply.size())) return;
+        }
+    }
+    connection->flush(1000);
+}
+
+/**
+ * @brief Runs one admin command and returns its reply.
+ *
+ * Reads shared counters and the sessions registry only, never mtx, so the
+ * answer comes back even while the serve path is congested.
+ *
+ * @param command The command line, e.g. "stats" or "loglevel warn".
+ * @return The reply, one or more lines.
+ */
+string runAdminCommand(const string& command) {
+    istringstream words(command);
+    string verb, argument;
+    words >> verb >> argument;
+    ostringstream reply;
+    reply << fixed << setprecision(1);
+
+    if (verb == "help") {
+        reply << "Commands: stats, connections, chefs, history [Client [FromSeconds [ToSeconds]]], top [Count], "
+                 "loglevel [warn|info|debug], pause, resume, drain, help\n";
+    } else if (verb == "stats") {
+        ShopSnapshot snapshot = shopSnapshot.load(); // Every figure from the same moment
+        auto now = chrono::steady_clock::now();
+        reply << "uptime_s " << chrono::duration<double>(now - shopOpened).count() << "\n"
+              << "snapshot_version " << snapshot.version << "\n"
+              << "snapshot_age_ms " << chrono::duration<double, milli>(now - snapshot.takenAt).count() << "\n"
+              << "shop " << kShopStateNames[static_cast<int>(snapshot.state)] << "\n"
+              << "max_burgers " << snapshot.maxBurgers << "\n"
+              << "burgers_assigned " << snapshot.burgersAssigned << "\n"
+              << "burgers_prepared " << snapshot.burgersPrepared << "\n"
+              << "burgers_served " << snapshot.burgersServed << "\n"
+              << "burgers_wasted " << snapshot.burgersWasted << "\n"
+              << "connections " << snapshot.connections << "\n"
+              << "sessions_opened " << sessionsOpened << "\n"
+              << "orders_placed " << snapshot.ordersPlaced << "\n"
+              << "orders_waiting " << snapshot.ordersWaiting << "\n"
+              << "orders_queued " << snapshot.ordersQueued << "\n"
+              << "queued_wait_mean_ms " << (snapshot.ordersQueued > 0 ? snapshot.queuedWaitMicros / 1000.0 / snapshot.ordersQueued : 0.0) << "\n"
+              << "udp_orders_shed " << snapshot.udpOrdersShed << "\n"
+              << "dispatch_policy " << dispatchPolicy << "\n"
+              << "log_level " << kLogLevelNames[logLevel] << "\n"
+              << "shard_stock";
+        for (int stock : snapshot.shardStock) reply << " " << stock;
+        reply << "\n";
+    } else if (verb == "connections") {
+        auto now = chrono::steady_clock::now();
+        lock_guard<mutex> lock(sessionsMtx);
+        reply << "id kind age_s orders waiting\n";
+        for (const auto& entry : sessions) {
+            const ClientSession& session = *entry.second;
+            reply << session.id << " " << session.kind.load() << " "
+                  << chrono::duration<double>(now - session.connectedAt).count() << " "
+                  << session.ordersTaken << " " << session.waiting << "\n";
+        }
+    } else if (verb == "chefs") {
+        double now = kitchenNow();
+        lock_guard<mutex> lock(kitchenMtx); // The dispatcher's lock, not the serve path's
+        reply << "name state burgers busy_s\n";
+        for (int i = 0; i < numChefs; ++i) {
+            const ChefState& chef = chefStates[i];
+            const char* state = chef.assigned ? "cooking" : chefProfiles[i].onShift(now) ? "idle" : "off-shift";
+            reply << chefProfiles[i].name << " " << state << " " << chef.burgersCooked << " " << chef.busySeconds << "\n";
+        }
+    } else if (verb == "history" && argument.empty()) {
+        OrderHistory::Usage usage = orderHistory.usage();
+        reply << "history_clients " << usage.clients << "\n"
+              << "history_orders " << usage.orders << "\n"
+              << "history_bytes " << usage.bytes << "\n"
+              << "history_bytes_per_order " << (usage.orders > 0 ? double(usage.bytes) / usage.orders : 0.0) << "\n";
+    } else if (verb == "history") {
+        uint64_t client = strtoull(argument.c_str() + (argument.compare(0, 4, "udp:") == 0 ? 4 : 0), nullptr, 10);
+        if (argument.compare(0, 4, "udp:") == 0) client |= kUdpHistoryClient;
+        double fromSeconds = 0, toSeconds = 1e12;
+        words >> fromSeconds >> toSeconds;
+        size_t listed = 0;
+        reply << "at_s item outcome\n" << setprecision(3);
+        size_t total = orderHistory.ordersOf(client, static_cast<int64_t>(fromSeconds * 1e6), static_cast<int64_t>(toSeconds * 1e6),
+                                             [&](const HistoryEntry& order) {
+            if (listed++ >= kHistoryReplyOrders) return;
+            reply << order.micros / 1e6 << " " << orderHistory.itemName(order.item) << " " << (order.outcome == OrderOutcome::Served ? "served" : "refused") << "\n";
+        });
+        if (total > kHistoryReplyOrders) reply << "... " << total - kHistoryReplyOrders << " more\n";
+    } else if (verb == "top") {
+        int count = argument.empty() ? 10 : max(atoi(argument.c_str()), 0);
+        reply << "client orders served\n";
+        for (const ClientTotals& totals : orderHistory.topClients(count)) {
+            reply << historyClientName(totals.client) << " " << totals.orders << " " << totals.served << "\n";
+        }
+    } else if (verb == "loglevel") {
+        if (!argument.empty()) {
+            auto known = find(begin(kLogLevelNames), end(kLogLevelNames), argument);
+            if (known == end(kLogLevelNames)) return "error: unknown log level " + argument + "\n";
+            logLevel = static_cast<int>(known - begin(kLogLevelNames));
+        }
+        reply << "log_level " << kLogLevelNames[logLevel] << "\n";
+    } else if (verb == "pause" || verb == "resume") {
+        {
+            lock_guard<mutex> lock(intakeMtx);
+            intakePaused = verb == "pause" && !draining;
+        }
+        cv_intake.notify_all();
+        reply << "intake " << (intakePaused ? "paused" : "running") << "\n";
+    } else if (verb == "drain") {
+        {
+            lock_guard<mutex> lock(intakeMtx);
+            draining = true;
+            intakePaused = false; // Paused clients could never finish
+        }
+        cv_intake.notify_all();
+        reply << "draining: no new connections; shutting down when the current clients leave\n";
+    } else {
+        reply << "error: unknown command " << verb << " (try help)\n";
+    }
+    return reply.str();
+}
+
+/**
+ * @brief Waits while the admin has paused intake.
+ *
+ * @param timeoutMs Longest time to wait.
+ * @return true if intake was paused (the caller should recheck its state), false right away otherwise.
+ */
+bool waitWhilePaused(int timeoutMs) {
+    if (!intakePaused) return false;
+    unique_lock<mutex> lock(intakeMtx);
+    cv_intake.wait_for(lock, chrono::milliseconds(timeoutMs), [] { return !intakePaused; });
+    return true;
+}
+
+/**
+ * @brief Records and reports a broken invariant.
+ *
+ * @param holds Whether the invariant holds.
+ * @param description What went wrong, for the log.
+ */
+void checkInvariant(bool holds, const char* description) {
+    if (holds) return;
+    invariantViolations++;
+    cerr << "Invariant violated: " << description << endl;
+}
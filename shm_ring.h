@@ -0,0 +1,310 @@
+/**
+ * @file shm_ring.h
+ * @brief Shared-memory ring transport for co-located clients.
+ *
+ * A channel is a pair of single-producer/single-consumer byte rings living in
+ * a memfd shared by the server and one client. Messages are length-prefixed
+ * records. Each side owns an eventfd which the producer only signals when the
+ * consumer has announced that it is going to sleep, so a busy exchange of
+ * orders and replies needs no system calls at all.
+ *
+ * The channel is negotiated over a Unix stream socket: the client sends
+ * "ShmRing", the server answers "ShmRing OK" and passes the memfd and both
+ * eventfds with SCM_RIGHTS. The socket stays open afterwards so either side
+ * notices when the other goes away. The server refuses with "Shared memory
+ * refused" unless the request is the first and only thing sent on a Unix
+ * stream connection.
+ *
+ * @author Michael Barry
+ */
+
+#ifndef BURGER_SHM_RING_H
+#define BURGER_SHM_RING_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+
+constexpr uint32_t kShmRingSize = 64 * 1024; // Bytes per direction, must be a power of two
+constexpr int kShmSpinCount = 2000; // Empty polls before a consumer goes to sleep
+constexpr int kShmFdCount = 3; // memfd, server eventfd, client eventfd
+constexpr int kShmHandshakeTimeoutMs = 5000; // How long a client waits for the server to answer "ShmRing"
+constexpr int kMaxPassedFds = 8; // Most descriptors sendWithFds/recvWithFds carry in one message
+constexpr int kShmRingEmpty = -1; // ShmRing::tryPop result when there is no record
+constexpr int kShmRingCorrupt = -2; // ShmRing::tryPop result when the producer published an impossible record
+
+/**
+ * @brief One direction of a shared-memory channel.
+ *
+ * head is only written by the producer, tail only by the consumer; both are
+ * free-running counters so the fill level is simply head - tail.
+ */
+struct ShmRing {
+    alignas(64) std::atomic<uint32_t> head; // Bytes published by the producer
+    alignas(64) std::atomic<uint32_t> tail; // Bytes consumed by the consumer
+    alignas(64) std::atomic<uint32_t> consumerSleeping; // Set while the consumer waits on its eventfd
+    alignas(64) char data[kShmRingSize];
+
+    /**
+     * @brief Copies bytes into the ring at a free-running offset, handling wrap-around.
+     */
+    void copyIn(uint32_t offset, const void* src, uint32_t len) {
+        uint32_t pos = offset & (kShmRingSize - 1);
+        uint32_t first = std::min(len, kShmRingSize - pos);
+        memcpy(data + pos, src, first);
+        memcpy(data, static_cast<const char*>(src) + first, len - first);
+    }
+
+    /**
+     * @brief Copies bytes out of the ring at a free-running offset, handling wrap-around.
+     */
+    void copyOut(uint32_t offset, void* dst, uint32_t len) const {
+        uint32_t pos = offset & (kShmRingSize - 1);
+        uint32_t first = std::min(len, kShmRingSize - pos);
+        memcpy(dst, data + pos, first);
+        memcpy(static_cast<char*>(dst) + first, data, len - first);
+    }
+
+    /**
+     * @brief Appends one record if there is room.
+     * @return true if the record was published, false if the ring is full.
+     */
+    bool tryPush(const char* message, uint32_t len) {
+        uint32_t h = head.load(std::memory_order_relaxed);
+        uint32_t t = tail.load(std::memory_order_acquire);
+        if (kShmRingSize - (h - t) < len + sizeof(uint32_t)) return false;
+        copyIn(h, &len, sizeof(len));
+        copyIn(h + sizeof(len), message, len);
+        head.store(h + sizeof(len) + len, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Copies out the next record, or as much of it as fits.
+     *
+     * The producer is the other process, so nothing it wrote is trusted: a head
+     * or record length that does not fit in the ring is reported, never followed.
+     * A record longer than the caller's buffer is handed out over several calls.
+     *
+     * @param delivered Bytes of the record at tail handed out by earlier calls; 0 between records.
+     * @return Bytes copied out, kShmRingEmpty, or kShmRingCorrupt.
+     */
+    int tryPop(char* buffer, uint32_t capacity, uint32_t& delivered) {
+        while (true) {
+            uint32_t t = tail.load(std::memory_order_relaxed);
+            uint32_t h = head.load(std::memory_order_acquire);
+            if (h == t) return kShmRingEmpty;
+            uint32_t available = h - t;
+            uint32_t len;
+            if (available > kShmRingSize || available < sizeof(len)) return kShmRingCorrupt;
+            copyOut(t, &len, sizeof(len));
+            if (len > available - sizeof(len) || delivered > len) return kShmRingCorrupt;
+            uint32_t copied = std::min(len - delivered, capacity);
+            copyOut(t + sizeof(len) + delivered, buffer, copied);
+            delivered += copied;
+            if (delivered == len) {
+                tail.store(t + sizeof(len) + len, std::memory_order_release);
+                delivered = 0;
+            }
+            if (copied > 0 || capacity == 0) return static_cast<int>(copied); // Skip empty records, 0 means disconnected
+        }
+    }
+};
+
+/**
+ * @brief The shared-memory layout of a channel.
+ */
+struct ShmChannel {
+    ShmRing toServer; // Orders from the client
+    ShmRing toClient; // Replies from the server
+};
+
+/**
+ * @brief One side of an established shared-memory channel.
+ */
+class ShmEndpoint {
+public:
+    ShmEndpoint() = default;
+    ShmEndpoint(const ShmEndpoint&) = delete;
+    ShmEndpoint& operator=(const ShmEndpoint&) = delete;
+
+    ~ShmEndpoint() {
+        if (channel != nullptr) munmap(channel, sizeof(ShmChannel));
+        if (memFd >= 0) close(memFd);
+        if (serverEvent >= 0) close(serverEvent);
+        if (clientEvent >= 0) close(clientEvent);
+    }
+
+    /**
+     * @brief Creates a fresh channel (server side).
+     * @return true on success.
+     */
+    bool create(int controlSocket) {
+        control = controlSocket;
+        isServer = true;
+        memFd = memfd_create("burger-shm-ring", MFD_CLOEXEC);
+        if (memFd < 0 || ftruncate(memFd, sizeof(ShmChannel)) < 0) return false;
+        serverEvent = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        clientEvent = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        if (serverEvent < 0 || clientEvent < 0) return false;
+        return map();
+    }
+
+    /**
+     * @brief Adopts a channel received from the server (client side).
+     * @return true on success.
+     */
+    bool attach(int controlSocket, const int fds[kShmFdCount]) {
+        control = controlSocket;
+        isServer = false;
+        memFd = fds[0];
+        serverEvent = fds[1];
+        clientEvent = fds[2];
+        return map();
+    }
+
+    /**
+     * @brief Sends the channel's descriptors over the control socket.
+     */
+    bool sendDescriptors(const char* message) const {
+        int fds[kShmFdCount] = {memFd, serverEvent, clientEvent};
+        return sendWithFds(control, message, strlen(message), fds, kShmFdCount);
+    }
+
+    /**
+     * @brief Publishes one message to the peer, waking it only if it sleeps.
+     * @param wait Whether to wait for room while the ring is full.
+     * @return false if the ring is full and wait is false, or the peer went away.
+     */
+    bool send(const char* message, size_t len, bool wait = true) {
+        ShmRing& ring = isServer ? channel->toClient : channel->toServer;
+        while (!ring.tryPush(message, static_cast<uint32_t>(len))) {
+            if (!wait || peerClosed()) return false;
+            std::this_thread::yield();
+        }
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (ring.consumerSleeping.load(std::memory_order_relaxed)) {
+            uint64_t one = 1;
+            ssize_t ignored = write(isServer ? clientEvent : serverEvent, &one, sizeof(one));
+            (void)ignored;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Receives one message, spinning briefly before sleeping on the eventfd.
+     * @param timeoutMs Longest time to sleep without a message, or -1 to wait forever.
+     * @return Length of the message, 0 once the peer has disconnected, -1 on timeout,
+     *         or kShmRingCorrupt if the peer broke the ring.
+     */
+    int recv(char* buffer, size_t capacity, int timeoutMs = -1) {
+        ShmRing& ring = isServer ? channel->toServer : channel->toClient;
+        int ownEvent = isServer ? serverEvent : clientEvent;
+        while (true) {
+            for (int spin = 0; spin < kShmSpinCount; ++spin) {
+                int len = ring.tryPop(buffer, static_cast<uint32_t>(capacity), delivered);
+                if (len != kShmRingEmpty) return len;
+            }
+
+            // Announce the sleep, then re-check so a concurrent push is never missed
+            ring.consumerSleeping.store(1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int len = ring.tryPop(buffer, static_cast<uint32_t>(capacity), delivered);
+            if (len != kShmRingEmpty) {
+                ring.consumerSleeping.store(0, std::memory_order_relaxed);
+                return len;
+            }
+
+            pollfd fds[2] = {{ownEvent, POLLIN, 0}, {control, POLLIN, 0}};
+            int ready = poll(fds, 2, timeoutMs);
+            ring.consumerSleeping.store(0, std::memory_order_relaxed);
+            if (ready == 0) {
+                len = ring.tryPop(buffer, static_cast<uint32_t>(capacity), delivered);
+                return len;
+            }
+            uint64_t count;
+            ssize_t ignored = read(ownEvent, &count, sizeof(count));
+            (void)ignored;
+            if ((fds[1].revents & (POLLIN | POLLHUP | POLLERR)) && peerClosed()) {
+                // Drain anything published before the peer left
+                len = ring.tryPop(buffer, static_cast<uint32_t>(capacity), delivered);
+                return len == kShmRingEmpty ? 0 : len;
+            }
+        }
+    }
+
+    /**
+     * @brief Sends a message together with file descriptors (SCM_RIGHTS).
+     */
+    static bool sendWithFds(int socket, const char* message, size_t len, const int* fds, int count) {
+        iovec iov{const_cast<char*>(message), len};
+        char control[CMSG_SPACE(sizeof(int) * kMaxPassedFds)] = {};
+        msghdr msg{};
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = CMSG_SPACE(sizeof(int) * count);
+        cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int) * count);
+        memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * count);
+        return sendmsg(socket, &msg, 0) == static_cast<ssize_t>(len);
+    }
+
+    /**
+     * @brief Receives a message together with up to kMaxPassedFds file descriptors.
+     * @param fds Receives the descriptors; must have room for kMaxPassedFds.
+     * @return Number of bytes received, or -1 on failure.
+     */
+    static int recvWithFds(int socket, char* buffer, size_t capacity, int* fds, int& count) {
+        iovec iov{buffer, capacity};
+        char control[CMSG_SPACE(sizeof(int) * kMaxPassedFds)] = {};
+        msghdr msg{};
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        ssize_t bytes = recvmsg(socket, &msg, MSG_CMSG_CLOEXEC);
+        count = 0;
+        for (cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+            if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+                count = std::min(kMaxPassedFds, static_cast<int>((cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int)));
+                memcpy(fds, CMSG_DATA(cmsg), sizeof(int) * count);
+            }
+        }
+        return static_cast<int>(bytes);
+    }
+
+private:
+    bool map() {
+        void* memory = mmap(nullptr, sizeof(ShmChannel), PROT_READ | PROT_WRITE, MAP_SHARED, memFd, 0);
+        if (memory == MAP_FAILED) return false;
+        channel = static_cast<ShmChannel*>(memory);
+        return true;
+    }
+
+    bool peerClosed() const {
+        pollfd fd{control, POLLIN, 0};
+        if (poll(&fd, 1, 0) <= 0) return false;
+        char probe;
+        return ::recv(control, &probe, 1, MSG_PEEK | MSG_DONTWAIT) == 0 || (fd.revents & (POLLHUP | POLLERR));
+    }
+
+    ShmChannel* channel = nullptr; // Mapped shared memory
+    int control = -1; // Unix socket used for negotiation and liveness (not owned)
+    int memFd = -1; // memfd backing the channel
+    int serverEvent = -1; // Wakes the server when it sleeps on toServer
+    int clientEvent = -1; // Wakes the client when it sleeps on toClient
+    bool isServer = false; // Which side of the channel this endpoint is
+    uint32_t delivered = 0; // Bytes of a record too long for the last recv() already received
+};
+
+#endif // BURGER_SHM_RING_H
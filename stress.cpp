@@ -0,0 +1,387 @@
+/**
+ * @file stress.cpp
+ * @brief Stress and soak harness that checks the burger shop's correctness invariants.
+ *
+ * Starts the server as a child process with many chefs and --check-invariants,
+ * runs hundreds of concurrent clients against it and verifies from the outside
+ * that every order is answered exactly once and that exactly MaxBurgers burgers
+ * are served. The server verifies served <= prepared itself and fails its exit
+ * status otherwise. With --duration, rounds repeat until the time is up.
+ *
+ * Point --server at a build made with -fsanitize=thread or -fsanitize=address to
+ * run the same load under a sanitizer; its reports appear on stderr and fail
+ * the round through the server's exit status.
+ *
+ * @author Michael Barry
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "transport.h"
+#include "message_parser.h"
+
+using namespace std;
+
+/**
+ * @brief Settings shared by every round.
+ */
+struct StressConfig {
+    string server = "./burger_shop_server"; // Server binary to test
+    string transport = "unix"; // unix, seqpacket, shm or tcp
+    string socketPath = "/tmp/burger-stress.sock"; // Unix socket the server listens on
+    string serverLog = "/dev/null"; // Where the server's stdout goes
+    int clients = 200; // Concurrent client sessions
+    int chefs = 16; // Chef threads in the server
+    int burgers = 0; // Burgers per round (0 = 10 per client)
+    int pipeline = 1; // Orders each client keeps in flight
+    double timeScale = 0.001; // Server --time-scale; 0.001 makes a burger take about 3 ms
+    int orderTimeoutMs = 5000; // An order unanswered for this long is a violation
+    double duration = 0; // Keep running rounds for this many seconds (0 = one round)
+    int workers = 0; // Server --workers; 0 runs it as a single process
+    int batch = 0; // Server --batch; 0 leaves it at one burger per grill load
+    int upgradeAfterMs = 0; // Hot-upgrade to a second server this long into each round (0 = never)
+};
+
+/**
+ * @brief What one client saw; violations are counted, not asserted, so a round always finishes.
+ */
+struct ClientStats {
+    long ordersSent = 0;
+    long served = 0; // "Burger Served" replies to orders
+    long refused = 0; // Orders answered "No more burgers" or outstanding when the shop closed the session
+    long unanswered = 0; // Violation: no reply within the order timeout
+    long dropped = 0; // Violation: connection lost with orders outstanding and no closing notice
+    long unsolicited = 0; // Violation: a burger served with no order outstanding
+    bool connectFailed = false; // Violation: could not connect at all
+    vector<double> latenciesMs; // Order-to-reply time of every answered order
+};
+
+/**
+ * @brief Totals of one round.
+ */
+struct RoundResult {
+    ClientStats totals;
+    double seconds = 0;
+    int serverStatus = 0; // Exit status, or 128 + signal
+    bool serverHung = false; // Server had to be killed after the clients finished
+    long violations = 0;
+};
+
+/**
+ * @brief Runs one client session: orders until the shop closes, checking every reply.
+ */
+void clientSession(const StressConfig& config, ClientStats& stats) {
+    string endpoint = config.transport == "tcp" ? "tcp:127.0.0.1:54321" : config.transport + ":" + config.socketPath;
+    unique_ptr<Transport> transport = transportFor(endpoint);
+    unique_ptr<Connection> connection;
+    auto connectDeadline = chrono::steady_clock::now() + chrono::seconds(5);
+    while (!(connection = transport->connect(endpoint)) && chrono::steady_clock::now() < connectDeadline) {
+        this_thread::sleep_for(chrono::milliseconds(10)); // The server may still be starting
+    }
+    if (!connection) {
+        stats.connectFailed = true;
+        return;
+    }
+
+    MessageParser parser;
+    deque<chrono::steady_clock::time_point> outstanding; // Send times of unanswered orders, oldest first
+    bool sessionOver = false;
+    bool connectionLost = false;
+    while (!sessionOver) {
+        while (outstanding.size() < static_cast<size_t>(config.pipeline)) {
+            if (!Message<MessageType::Order>::send(*connection)) break;
+            outstanding.push_back(chrono::steady_clock::now());
+            stats.ordersSent++;
+        }
+
+        MessageType reply;
+        if (!parser.next(reply)) {
+            if (outstanding.empty()) {
+                connectionLost = true; // The server stopped taking orders
+                break;
+            }
+            auto now = chrono::steady_clock::now();
+            auto waited = chrono::duration_cast<chrono::milliseconds>(now - outstanding.front()).count();
+            size_t space;
+            char* receiveInto = parser.writeSpan(space);
+            int bytesReceived = connection->recv(receiveInto, space, max<long>(0, config.orderTimeoutMs - waited));
+            if (bytesReceived == kRecvTimedOut) {
+                stats.unanswered += outstanding.size();
+                return;
+            }
+            if (bytesReceived <= 0) {
+                connectionLost = true;
+                break;
+            }
+            parser.commit(bytesReceived);
+            continue;
+        }
+
+        if (outstanding.empty()) {
+            if (reply == MessageType::BurgerServed) stats.unsolicited++;
+            sessionOver = reply == MessageType::NoMoreBurgers; // Closing notice after the last burger
+            continue;
+        }
+        stats.latenciesMs.push_back(chrono::duration<double, milli>(chrono::steady_clock::now() - outstanding.front()).count());
+        outstanding.pop_front();
+        if (reply == MessageType::BurgerServed) {
+            stats.served++;
+        } else if (reply == MessageType::NoMoreBurgers) {
+            stats.refused++;
+            sessionOver = true;
+        }
+    }
+
+    if (connectionLost) {
+        stats.dropped += outstanding.size();
+        return;
+    }
+
+    // The shop ends the session once it is out; orders still in flight are turned away,
+    // but no burger may be served after the closing notice
+    stats.refused += outstanding.size();
+    MessageType reply;
+    while (true) {
+        while (parser.next(reply)) {
+            if (reply == MessageType::BurgerServed) stats.unsolicited++;
+        }
+        size_t space;
+        char* receiveInto = parser.writeSpan(space);
+        int bytesReceived = connection->recv(receiveInto, space, 200);
+        if (bytesReceived <= 0) break;
+        parser.commit(bytesReceived);
+    }
+}
+
+/**
+ * @brief Starts the server under test.
+ * @return Its process id, or -1 if it could not be started.
+ */
+pid_t startServer(const StressConfig& config, int burgers) {
+    vector<string> args = {config.server, to_string(burgers), to_string(config.chefs),
+                           "--time-scale", to_string(config.timeScale), "--check-invariants"};
+    if (config.transport == "unix" || config.transport == "shm") {
+        args.insert(args.end(), {"--unix", config.socketPath});
+    } else if (config.transport == "seqpacket") {
+        args.insert(args.end(), {"--seqpacket", config.socketPath});
+    }
+    if (config.workers > 0) args.insert(args.end(), {"--workers", to_string(config.workers)});
+    if (config.batch > 0) args.insert(args.end(), {"--batch", to_string(config.batch)});
+    if (config.upgradeAfterMs > 0) args.insert(args.end(), {"--upgrade-socket", config.socketPath + ".upgrade"});
+
+    pid_t pid = fork();
+    if (pid != 0) return pid;
+    int log = open(config.serverLog.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (log >= 0) dup2(log, STDOUT_FILENO);
+    vector<char*> argv;
+    for (string& arg : args) argv.push_back(&arg[0]);
+    argv.push_back(nullptr);
+    execv(argv[0], argv.data());
+    perror("Cannot start server");
+    _exit(127);
+}
+
+/**
+ * @brief Waits for the server to exit, killing it if it does not within timeoutMs.
+ * @return Exit status, 128 + signal number if it was killed by a signal.
+ */
+int waitForServer(pid_t pid, int timeoutMs, bool& hung) {
+    int status = 0;
+    auto deadline = chrono::steady_clock::now() + chrono::milliseconds(timeoutMs);
+    while (waitpid(pid, &status, WNOHANG) == 0) {
+        if (chrono::steady_clock::now() >= deadline) {
+            hung = true;
+            kill(pid, SIGKILL);
+            waitpid(pid, &status, 0);
+            break;
+        }
+        this_thread::sleep_for(chrono::milliseconds(10));
+    }
+    return WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+}
+
+/**
+ * @brief Runs one server with every client against it and checks the invariants.
+ */
+RoundResult runRound(const StressConfig& config) {
+    int burgers = config.burgers > 0 ? config.burgers : config.clients * 10;
+    RoundResult result;
+    pid_t server = startServer(config, burgers);
+    if (server < 0) {
+        perror("fork failed");
+        result.serverStatus = 127;
+        result.violations = 1;
+        return result;
+    }
+
+    auto start = chrono::steady_clock::now();
+    vector<ClientStats> stats(config.clients);
+    vector<thread> clients;
+    for (int i = 0; i < config.clients; ++i) {
+        clients.emplace_back(clientSession, cref(config), ref(stats[i]));
+    }
+
+    // A second server started with the same arguments takes over the first one's shop
+    // while its clients are still ordering
+    pid_t successor = -1;
+    atomic<bool> clientsDone(false);
+    thread upgrader;
+    if (config.upgradeAfterMs > 0) {
+        upgrader = thread([&config, &successor, &clientsDone, burgers, start]() {
+            while (!clientsDone && chrono::steady_clock::now() - start < chrono::milliseconds(config.upgradeAfterMs)) {
+                this_thread::sleep_for(chrono::milliseconds(1));
+            }
+            if (!clientsDone) successor = startServer(config, burgers);
+        });
+    }
+    for (auto& client : clients) {
+        client.join();
+    }
+    clientsDone = true;
+    if (upgrader.joinable()) upgrader.join();
+    result.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    result.serverStatus = waitForServer(server, 10000, result.serverHung);
+    if (successor > 0) {
+        int successorStatus = waitForServer(successor, 10000, result.serverHung);
+        if (result.serverStatus == 0) result.serverStatus = successorStatus;
+    } else if (config.upgradeAfterMs > 0) {
+        cout << "  round ended before the upgrade" << endl;
+    }
+
+    ClientStats& totals = result.totals;
+    long connectFailures = 0;
+    for (ClientStats& client : stats) {
+        totals.ordersSent += client.ordersSent;
+        totals.served += client.served;
+        totals.refused += client.refused;
+        totals.unanswered += client.unanswered;
+        totals.dropped += client.dropped;
+        totals.unsolicited += client.unsolicited;
+        connectFailures += client.connectFailed;
+        totals.latenciesMs.insert(totals.latenciesMs.end(), client.latenciesMs.begin(), client.latenciesMs.end());
+    }
+
+    // Each violated invariant is reported once per round
+    auto violation = [&result](bool broken, const string& description) {
+        if (!broken) return;
+        result.violations++;
+        cout << "  VIOLATION: " << description << endl;
+    };
+    if (connectFailures > 0 && totals.served == burgers) {
+        cout << "  " << connectFailures << " clients arrived after the shop sold out" << endl;
+    } else {
+        violation(connectFailures > 0, to_string(connectFailures) + " clients could not connect");
+    }
+    violation(totals.unanswered > 0, to_string(totals.unanswered) + " orders unanswered after " +
+                                         to_string(config.orderTimeoutMs) + " ms");
+    violation(totals.dropped > 0, to_string(totals.dropped) + " orders lost when the server closed the connection");
+    violation(totals.unsolicited > 0, to_string(totals.unsolicited) + " burgers served without an order");
+    violation(totals.served != burgers, "served " + to_string(totals.served) + " burgers, expected " + to_string(burgers));
+    violation(result.serverHung, "server did not shut down after the last client left");
+    violation(result.serverStatus != 0, "server exited with status " + to_string(result.serverStatus));
+    return result;
+}
+
+/**
+ * @brief Prints one round's throughput and latency.
+ */
+void printRound(int round, RoundResult& result) {
+    vector<double>& latencies = result.totals.latenciesMs;
+    sort(latencies.begin(), latencies.end());
+    auto percentile = [&latencies](double p) {
+        return latencies.empty() ? 0.0 : latencies[min(latencies.size() - 1, static_cast<size_t>(p * latencies.size()))];
+    };
+    long answered = result.totals.served + result.totals.refused;
+    cout << setw(6) << round << setw(10) << result.totals.ordersSent << setw(10) << result.totals.served
+         << setw(10) << fixed << setprecision(2) << result.seconds
+         << setw(12) << setprecision(0) << answered / max(result.seconds, 1e-9)
+         << setw(10) << setprecision(2) << percentile(0.5) << setw(10) << percentile(0.99)
+         << setw(12) << (result.violations == 0 ? "ok" : "FAILED") << endl;
+}
+
+/**
+ * @brief The main function for the stress harness.
+ *
+ * @param argc The number of command line arguments.
+ * @param argv An array of command line arguments.
+ * @return int Returns 0 if every invariant held in every round, 1 otherwise.
+ */
+int main(int argc, char* argv[]) {
+    StressConfig config;
+    bool usageError = false;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--server" && i + 1 < argc) {
+            config.server = argv[++i];
+        } else if (arg == "--transport" && i + 1 < argc) {
+            config.transport = argv[++i];
+        } else if (arg == "--socket" && i + 1 < argc) {
+            config.socketPath = argv[++i];
+        } else if (arg == "--server-log" && i + 1 < argc) {
+            config.serverLog = argv[++i];
+        } else if (arg == "--clients" && i + 1 < argc) {
+            config.clients = atoi(argv[++i]);
+        } else if (arg == "--chefs" && i + 1 < argc) {
+            config.chefs = atoi(argv[++i]);
+        } else if (arg == "--burgers" && i + 1 < argc) {
+            config.burgers = atoi(argv[++i]);
+        } else if (arg == "--pipeline" && i + 1 < argc) {
+            config.pipeline = atoi(argv[++i]);
+        } else if (arg == "--time-scale" && i + 1 < argc) {
+            config.timeScale = atof(argv[++i]);
+        } else if (arg == "--order-timeout" && i + 1 < argc) {
+            config.orderTimeoutMs = atoi(argv[++i]);
+        } else if (arg == "--duration" && i + 1 < argc) {
+            config.duration = atof(argv[++i]);
+        } else if (arg == "--workers" && i + 1 < argc) {
+            config.workers = atoi(argv[++i]);
+        } else if (arg == "--batch" && i + 1 < argc) {
+            config.batch = atoi(argv[++i]);
+        } else if (arg == "--upgrade-after" && i + 1 < argc) {
+            config.upgradeAfterMs = atoi(argv[++i]);
+        } else {
+            usageError = true;
+        }
+    }
+    const string transports[] = {"unix", "seqpacket", "shm", "tcp"};
+    if (usageError || config.clients < 1 || config.chefs < 1 || config.pipeline < 1 || (config.workers > 0 && config.upgradeAfterMs > 0) ||
+        find(begin(transports), end(transports), config.transport) == end(transports)) {
+        cout << "Usage: " << argv[0] << " [--server <Binary>] [--transport unix|seqpacket|shm|tcp] [--socket <Path>]"
+             << " [--server-log <File>] [--clients <Count>] [--chefs <Count>] [--burgers <Count>] [--pipeline <Orders>]"
+             << " [--time-scale <Factor>] [--order-timeout <Ms>] [--duration <Seconds>]"
+             << " [--workers <Processes> | --upgrade-after <Ms>] [--batch <Burgers>]" << endl;
+        return 1;
+    }
+
+    cout << "Stressing " << config.server << " with " << config.clients << " " << config.transport << " clients and "
+         << config.chefs << " chefs." << endl;
+    cout << setw(6) << "Round" << setw(10) << "Orders" << setw(10) << "Served" << setw(10) << "Time (s)"
+         << setw(12) << "Answers/s" << setw(10) << "P50 ms" << setw(10) << "P99 ms" << setw(12) << "Invariants" << endl;
+
+    auto soakStart = chrono::steady_clock::now();
+    int rounds = 0;
+    int failedRounds = 0;
+    do {
+        RoundResult result = runRound(config);
+        printRound(++rounds, result);
+        if (result.violations > 0) failedRounds++;
+    } while (chrono::duration<double>(chrono::steady_clock::now() - soakStart).count() < config.duration);
+
+    cout << rounds << " rounds, " << failedRounds << " with invariant violations." << endl;
+    return failedRounds == 0 ? 0 : 1;
+}
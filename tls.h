@@ -0,0 +1,464 @@
+/**
+ * @file tls.h
+ * @brief Optional TLS transport built on OpenSSL.
+ *
+ * Only compiled when BURGER_TLS is defined (link with -lssl -lcrypto). A TLS
+ * connection wraps an accepted or connected TCP socket, switched to non-blocking
+ * mode so it follows the same rules as every other Connection: send() never
+ * blocks and queues what the socket does not take, recv() drains the queue while
+ * it waits.
+ *
+ * The server side performs its handshake lazily on the first recv(), in the
+ * client handler thread, so a slow or hostile client never stalls the accept
+ * loop. Session tickets are on, and a client that kept the session from an
+ * earlier connection (in memory, or in a session file between runs) resumes it
+ * with an abbreviated handshake that skips certificate signing and verification.
+ * Handshake counts and times are collected in tlsStats().
+ *
+ * @author Michael Barry
+ */
+
+#ifndef BURGER_TLS_H
+#define BURGER_TLS_H
+
+#ifdef BURGER_TLS
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <fcntl.h>
+#include <poll.h>
+#include <openssl/err.h>
+#include <openssl/pem.h>
+#include <openssl/ssl.h>
+#include <openssl/x509v3.h>
+#include "transport.h"
+
+/**
+ * @brief Handshake counters shared by every TLS connection in the process.
+ */
+struct TlsStats {
+    std::atomic<long> fullHandshakes{0}; // Handshakes that negotiated a new session
+    std::atomic<long> resumedHandshakes{0}; // Handshakes that resumed a ticket
+    std::atomic<long> failedHandshakes{0}; // Handshakes that failed (or, connecting, timed out)
+    std::atomic<long long> fullMicros{0}; // Total wall time of full handshakes
+    std::atomic<long long> resumedMicros{0}; // Total wall time of resumed handshakes
+};
+
+inline TlsStats& tlsStats() {
+    static TlsStats stats;
+    return stats;
+}
+
+/**
+ * @brief Text of the most recent OpenSSL error, for logging.
+ */
+inline std::string tlsError() {
+    char text[256] = "unknown TLS error";
+    unsigned long code = ERR_get_error();
+    if (code != 0) ERR_error_string_n(code, text, sizeof(text));
+    ERR_clear_error();
+    return text;
+}
+
+/**
+ * @brief Why the calling thread's most recent handshake failed.
+ */
+inline std::string& lastTlsError() {
+    thread_local std::string error;
+    return error;
+}
+
+/**
+ * @brief An SSL_CTX plus the session a client keeps for resumption.
+ */
+class TlsContext {
+public:
+    ~TlsContext() {
+        if (session) SSL_SESSION_free(session);
+        SSL_CTX_free(ctx);
+    }
+
+    /**
+     * @brief Creates a server context from a PEM certificate chain and private key.
+     * @return The context, or nullptr with error set.
+     */
+    static std::shared_ptr<TlsContext> server(const std::string& certPath, const std::string& keyPath, std::string& error) {
+        std::shared_ptr<TlsContext> context(new TlsContext(SSL_CTX_new(TLS_server_method())));
+        if (!context->ctx) {
+            error = tlsError();
+            return nullptr;
+        }
+        if (SSL_CTX_use_certificate_chain_file(context->ctx, certPath.c_str()) != 1 ||
+            SSL_CTX_use_PrivateKey_file(context->ctx, keyPath.c_str(), SSL_FILETYPE_PEM) != 1 ||
+            SSL_CTX_check_private_key(context->ctx) != 1) {
+            error = tlsError();
+            return nullptr;
+        }
+        static const unsigned char sessionContext[] = "burger-shop";
+        SSL_CTX_set_session_id_context(context->ctx, sessionContext, sizeof(sessionContext) - 1);
+        SSL_CTX_set_session_cache_mode(context->ctx, SSL_SESS_CACHE_SERVER);
+        return context;
+    }
+
+    /**
+     * @brief Creates a client context.
+     *
+     * @param caPath PEM file of trusted certificates, or empty for the system store.
+     * @param sessionPath File the session is loaded from and saved to, or empty to
+     *        keep it in memory only.
+     * @return The context, or nullptr with error set.
+     */
+    static std::shared_ptr<TlsContext> client(const std::string& caPath, const std::string& sessionPath, std::string& error) {
+        std::shared_ptr<TlsContext> context(new TlsContext(SSL_CTX_new(TLS_client_method())));
+        if (!context->ctx) {
+            error = tlsError();
+            return nullptr;
+        }
+        int loaded = caPath.empty() ? SSL_CTX_set_default_verify_paths(context->ctx)
+                                    : SSL_CTX_load_verify_locations(context->ctx, caPath.c_str(), nullptr);
+        if (loaded != 1) {
+            error = tlsError();
+            return nullptr;
+        }
+        SSL_CTX_set_verify(context->ctx, SSL_VERIFY_PEER, nullptr);
+
+        // TLS 1.3 tickets arrive after the handshake; keep the newest one
+        SSL_CTX_set_session_cache_mode(context->ctx, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+        SSL_CTX_set_ex_data(context->ctx, contextIndex(), context.get());
+        SSL_CTX_sess_set_new_cb(context->ctx, onNewSession);
+        context->sessionPath = sessionPath;
+        if (!sessionPath.empty()) {
+            FILE* file = fopen(sessionPath.c_str(), "r");
+            if (file) {
+                context->session = PEM_read_SSL_SESSION(file, nullptr, nullptr, nullptr);
+                fclose(file);
+                ERR_clear_error(); // A stale or corrupt file just means a full handshake
+            }
+        }
+        return context;
+    }
+
+    /**
+     * @brief Creates an SSL object for one connection, offering the kept session.
+     * @param host The address the certificate must be issued for (clients only).
+     */
+    SSL* newConnection(const std::string& host) {
+        SSL* ssl = SSL_new(ctx);
+        if (!ssl || host.empty()) return ssl;
+        X509_VERIFY_PARAM* param = SSL_get0_param(ssl);
+        if (X509_VERIFY_PARAM_set1_ip_asc(param, host.c_str()) != 1) {
+            X509_VERIFY_PARAM_set1_host(param, host.c_str(), 0);
+            SSL_set_tlsext_host_name(ssl, host.c_str());
+        }
+        // OpenSSL retires a TLS 1.3 session once used; offer a copy so the kept
+        // ticket stays valid until the server sends a fresh one
+        std::lock_guard<std::mutex> lock(sessionMutex);
+        if (session) {
+            SSL_SESSION* copy = SSL_SESSION_dup(session);
+            if (copy) {
+                SSL_set_session(ssl, copy);
+                SSL_SESSION_free(copy);
+            }
+        }
+        return ssl;
+    }
+
+    /**
+     * @brief Forgets the kept session so the next connection does a full handshake.
+     */
+    void dropSession() {
+        std::lock_guard<std::mutex> lock(sessionMutex);
+        if (session) SSL_SESSION_free(session);
+        session = nullptr;
+    }
+
+private:
+    explicit TlsContext(SSL_CTX* ctx) : ctx(ctx) {}
+
+    static int contextIndex() {
+        static int index = SSL_CTX_get_ex_new_index(0, nullptr, nullptr, nullptr, nullptr);
+        return index;
+    }
+
+    /**
+     * @brief OpenSSL callback for every ticket the server issues; takes ownership.
+     */
+    static int onNewSession(SSL* ssl, SSL_SESSION* newSession) {
+        TlsContext* context = static_cast<TlsContext*>(SSL_CTX_get_ex_data(SSL_get_SSL_CTX(ssl), contextIndex()));
+        std::lock_guard<std::mutex> lock(context->sessionMutex);
+        if (context->session) SSL_SESSION_free(context->session);
+        context->session = newSession;
+        if (!context->sessionPath.empty()) {
+            FILE* file = fopen(context->sessionPath.c_str(), "w");
+            if (file) {
+                PEM_write_SSL_SESSION(file, newSession);
+                fclose(file);
+            }
+        }
+        return 1;
+    }
+
+    SSL_CTX* ctx; // Shared configuration
+    std::mutex sessionMutex; // Guards session
+    SSL_SESSION* session = nullptr; // Client: newest ticket, offered on the next connect
+    std::string sessionPath; // Client: where the ticket persists between runs
+};
+
+/**
+ * @brief A TLS connection over a non-blocking TCP socket.
+ */
+class TlsConnection : public Connection {
+public:
+    TlsConnection(int fd, SSL* ssl, bool serverSide, std::shared_ptr<TlsContext> context)
+        : fd(fd), ssl(ssl), context(std::move(context)) {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        SSL_set_fd(ssl, fd);
+        SSL_set_mode(ssl, SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+        if (serverSide) {
+            SSL_set_accept_state(ssl);
+        } else {
+            SSL_set_connect_state(ssl);
+        }
+    }
+    ~TlsConnection() override {
+        if (handshakeDone) SSL_shutdown(ssl); // Best effort close_notify; never waits
+        SSL_free(ssl);
+        close(fd);
+    }
+
+    /**
+     * @brief Runs the handshake to completion and records its cost.
+     * @param timeoutMs Longest time to wait for the peer, or -1 to wait forever.
+     *        The cost recorded covers every attempt since the first.
+     * @return 1 when done, 0 if it failed, kRecvTimedOut if the peer was too slow.
+     */
+    int handshake(int timeoutMs) {
+        if (handshakeDone) return 1;
+        auto now = std::chrono::steady_clock::now();
+        if (handshakeStarted == std::chrono::steady_clock::time_point()) handshakeStarted = now;
+        auto deadline = now + std::chrono::milliseconds(timeoutMs);
+        while (true) {
+            short events;
+            {
+                std::lock_guard<std::mutex> lock(sslMutex);
+                int result = SSL_do_handshake(ssl);
+                if (result == 1) {
+                    handshakeDone = true;
+                    long long micros = std::chrono::duration_cast<std::chrono::microseconds>(
+                        std::chrono::steady_clock::now() - handshakeStarted).count();
+                    TlsStats& stats = tlsStats();
+                    if (SSL_session_reused(ssl)) {
+                        stats.resumedHandshakes++;
+                        stats.resumedMicros += micros;
+                    } else {
+                        stats.fullHandshakes++;
+                        stats.fullMicros += micros;
+                    }
+                    break;
+                }
+                int error = SSL_get_error(ssl, result);
+                if (error != SSL_ERROR_WANT_READ && error != SSL_ERROR_WANT_WRITE) {
+                    tlsStats().failedHandshakes++;
+                    long verified = SSL_get_verify_result(ssl);
+                    lastTlsError() = verified != X509_V_OK ? X509_verify_cert_error_string(verified) : tlsError();
+                    return 0;
+                }
+                events = error == SSL_ERROR_WANT_READ ? POLLIN : POLLOUT;
+            }
+            int waitMs = timeoutMs < 0 ? -1 : remainingMs(deadline);
+            pollfd pfd{fd, events, 0};
+            int ready = poll(&pfd, 1, waitMs);
+            if (ready < 0) {
+                tlsStats().failedHandshakes++;
+                lastTlsError() = strerror(errno);
+                return 0;
+            }
+            if (ready == 0 && timeoutMs >= 0) return kRecvTimedOut; // The caller may try again
+        }
+        std::lock_guard<std::mutex> lock(sslMutex);
+        return flushOutboxLocked() ? 1 : 0; // Replies queued during the handshake
+    }
+
+    bool resumed() const { return handshakeDone && SSL_session_reused(ssl); }
+
+    bool send(const char* message, size_t len) override {
+        std::lock_guard<std::mutex> lock(sslMutex);
+        if (outbox.empty() && handshakeDone) {
+            int written = SSL_write(ssl, message, static_cast<int>(len));
+            if (written > 0) return true; // Partial writes are off: all or nothing
+            int error = SSL_get_error(ssl, written);
+            if (error != SSL_ERROR_WANT_READ && error != SSL_ERROR_WANT_WRITE) return false;
+        }
+        if (outbox.empty()) outputQueued.notify(); // recv() may be waiting without POLLOUT
+        outbox.emplace_back(message, len);
+        outboxBytes += len;
+        return outboxBytes <= sendLimit;
+    }
+
+    int recv(char* buffer, size_t capacity, int timeoutMs = -1) override {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+        if (!handshakeDone) {
+            int done = handshake(timeoutMs);
+            if (done != 1) return done == 0 ? -1 : kRecvTimedOut;
+        }
+        while (true) {
+            short events = POLLIN;
+            {
+                std::lock_guard<std::mutex> lock(sslMutex);
+                if (!flushOutboxLocked()) return -1;
+                if (!outbox.empty()) events |= POLLOUT;
+                int received = SSL_read(ssl, buffer, static_cast<int>(capacity));
+                if (received > 0) return received;
+                int error = SSL_get_error(ssl, received);
+                if (error == SSL_ERROR_ZERO_RETURN) return 0;
+                if (error == SSL_ERROR_SYSCALL && ERR_peek_error() == 0) return 0; // Peer closed without close_notify
+                if (error == SSL_ERROR_WANT_WRITE) {
+                    events |= POLLOUT;
+                } else if (error != SSL_ERROR_WANT_READ) {
+                    ERR_clear_error();
+                    return -1;
+                }
+            }
+            pollfd pfds[2] = {{fd, events, 0}, {outputQueued.pollFd(), POLLIN, 0}};
+            int ready = poll(pfds, 2, timeoutMs < 0 ? -1 : remainingMs(deadline));
+            if (ready < 0) return -1;
+            if (ready == 0 && timeoutMs >= 0) return kRecvTimedOut;
+            if (pfds[1].revents & POLLIN) outputQueued.clear(); // Loop to flush it
+        }
+    }
+
+    void flush(int timeoutMs) override {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+        while (handshakeDone && std::chrono::steady_clock::now() < deadline) {
+            {
+                std::lock_guard<std::mutex> lock(sslMutex);
+                if (!flushOutboxLocked() || outbox.empty()) return;
+            }
+            pollfd pfd{fd, POLLOUT, 0};
+            if (poll(&pfd, 1, 10) < 0) return;
+        }
+    }
+
+    void closeGracefully(int timeoutMs) override {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+        flush(timeoutMs);
+        {
+            std::lock_guard<std::mutex> lock(sslMutex);
+            if (!handshakeDone || !outbox.empty()) return; // Unsent replies would be lost anyway
+            SSL_shutdown(ssl); // close_notify ahead of the FIN
+        }
+        lingerBeforeClose(fd, deadline);
+    }
+
+    const char* kind() const override { return "tls"; }
+    int socketFd() const override { return fd; }
+
+private:
+    static int remainingMs(std::chrono::steady_clock::time_point deadline) {
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+        return static_cast<int>(std::max<long>(0, left.count()));
+    }
+
+    /**
+     * @brief Encrypts as much queued output as the socket takes without blocking.
+     * @return false if the connection failed.
+     */
+    bool flushOutboxLocked() {
+        while (handshakeDone && !outbox.empty()) {
+            const std::string& front = outbox.front();
+            int written = SSL_write(ssl, front.data(), static_cast<int>(front.size()));
+            if (written <= 0) {
+                int error = SSL_get_error(ssl, written);
+                return error == SSL_ERROR_WANT_READ || error == SSL_ERROR_WANT_WRITE;
+            }
+            outboxBytes -= front.size();
+            outbox.pop_front();
+        }
+        return true;
+    }
+
+    int fd; // Non-blocking TCP socket
+    SSL* ssl; // Session state; not thread-safe, so guarded by sslMutex
+    std::shared_ptr<TlsContext> context; // Keeps the SSL_CTX alive
+    std::mutex sslMutex; // Serializes every use of ssl
+    std::atomic<bool> handshakeDone{false}; // Set once the handshake completed
+    std::chrono::steady_clock::time_point handshakeStarted; // First handshake attempt
+    std::deque<std::string> outbox; // Plaintext messages not yet accepted by SSL_write
+    size_t outboxBytes = 0; // Total bytes in outbox
+    OutputWakeup outputQueued; // Signalled when outbox stops being empty
+};
+
+/**
+ * @brief Accepts TCP connections and wraps them in server-side TLS.
+ */
+class TlsListener : public Listener {
+public:
+    TlsListener(std::unique_ptr<Listener> tcp, std::shared_ptr<TlsContext> context)
+        : tcp(std::move(tcp)), context(std::move(context)) {}
+
+    std::unique_ptr<Connection> accept() override {
+        std::unique_ptr<Connection> plain = tcp->accept();
+        if (!plain) return nullptr;
+        SSL* ssl = context->newConnection("");
+        if (!ssl) return nullptr;
+        int fd = static_cast<SocketConnection&>(*plain).release();
+        return std::unique_ptr<Connection>(new TlsConnection(fd, ssl, true, context));
+    }
+
+    int pollFd() const override { return tcp->pollFd(); }
+    const char* kind() const override { return "tls"; }
+
+private:
+    std::unique_ptr<Listener> tcp; // The underlying TCP listener
+    std::shared_ptr<TlsContext> context; // Certificate and ticket keys
+};
+
+/**
+ * @brief TLS over TCP. Addresses are "<ip>:<port>" as for TcpTransport.
+ */
+class TlsTransport : public Transport {
+public:
+    explicit TlsTransport(std::shared_ptr<TlsContext> context, bool reusePort = false)
+        : context(std::move(context)), reusePort(reusePort) {}
+
+    std::unique_ptr<Listener> listen(const std::string& address) override {
+        std::unique_ptr<Listener> tcp = TcpTransport(reusePort).listen(address);
+        if (!tcp) return nullptr;
+        return std::unique_ptr<Listener>(new TlsListener(std::move(tcp), context));
+    }
+
+    /**
+     * @brief Connects and completes the handshake before returning.
+     */
+    std::unique_ptr<Connection> connect(const std::string& address) override {
+        std::unique_ptr<Connection> plain = TcpTransport().connect(address);
+        if (!plain) return nullptr;
+        SSL* ssl = context->newConnection(address.substr(0, address.rfind(':')));
+        if (!ssl) return nullptr;
+        int fd = static_cast<SocketConnection&>(*plain).release();
+        std::unique_ptr<TlsConnection> connection(new TlsConnection(fd, ssl, false, context));
+        int done = connection->handshake(kHandshakeTimeoutMs);
+        if (done != 1) {
+            if (done == kRecvTimedOut) {
+                tlsStats().failedHandshakes++;
+                lastTlsError() = "handshake timed out";
+            }
+            return nullptr;
+        }
+        return connection;
+    }
+
+    static constexpr int kHandshakeTimeoutMs = 5000; // Give up on servers that never answer
+
+private:
+    std::shared_ptr<TlsContext> context; // Trust store and kept session
+    bool reusePort; // Whether listeners share their port with other processes (SO_REUSEPORT)
+};
+
+#endif // BURGER_TLS
+
+#endif // BURGER_TLS_H
@@ -0,0 +1,735 @@
+/**
+ * @file transport.h
+ * @brief Pluggable transports shared by the burger shop server and client.
+ *
+ * A Transport creates Listeners (server side) and Connections (client side) for
+ * one kind of endpoint. Endpoints are written as "<scheme>:<address>":
+ *
+ *  - tcp:<ip>:<port>      TCP socket
+ *  - unix:<path>          Unix stream socket
+ *  - seqpacket:<path>     Unix SOCK_SEQPACKET socket
+ *  - shm:<path>           Shared-memory ring negotiated over a Unix stream socket
+ *  - loopback:<name>      In-process message queues, no kernel networking at all
+ *
+ * Every connection carries whole messages: one send() is one recv() on the other
+ * side for the message-oriented transports, and the same best effort as the raw
+ * socket for stream transports.
+ *
+ * send() never blocks. Whatever the peer has not yet accepted waits in a bounded
+ * per-connection output buffer that recv() and flush() drain; once more than the
+ * send limit is waiting the peer counts as a slow consumer and send() fails, so
+ * the caller can disconnect it instead of stalling. A send() from another thread
+ * that starts the buffer wakes a recv() in progress, so the output does not wait
+ * for the recv() timeout.
+ *
+ * @author Michael Barry
+ */
+
+#ifndef BURGER_TRANSPORT_H
+#define BURGER_TRANSPORT_H
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <unistd.h>
+#include <poll.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "protocol.h"
+#include "shm_ring.h"
+
+constexpr int kRecvTimedOut = -2; // Connection::recv result when the timeout expired
+constexpr size_t kDefaultSendLimit = 64 * 1024; // Bytes a peer may leave unread before it counts as slow
+
+/**
+ * @brief A bidirectional message connection.
+ */
+class Connection {
+public:
+    virtual ~Connection() = default;
+
+    /**
+     * @brief Sends one message without blocking. Safe to call from any thread.
+     * @return false if the connection failed or the peer has more than the send limit unread.
+     */
+    virtual bool send(const char* message, size_t len) = 0;
+
+    /**
+     * @brief Receives one message, draining buffered output while waiting.
+     * @param timeoutMs Longest time to wait, or -1 to wait forever.
+     * @return Bytes received, 0 on disconnect, -1 on error or kRecvTimedOut.
+     */
+    virtual int recv(char* buffer, size_t capacity, int timeoutMs = -1) = 0;
+
+    /**
+     * @brief Waits up to timeoutMs for buffered output to reach the peer.
+     */
+    virtual void flush(int timeoutMs) { (void)timeoutMs; }
+
+    /**
+     * @brief Flushes, then ends the connection so the peer reads every reply before it sees the close.
+     *
+     * Waits up to timeoutMs in total; the connection is unusable afterwards except for destruction.
+     */
+    virtual void closeGracefully(int timeoutMs) { flush(timeoutMs); }
+
+    /**
+     * @brief Name of the transport, for logging.
+     */
+    virtual const char* kind() const = 0;
+
+    /**
+     * @brief The underlying socket, or -1 if the transport has none.
+     */
+    virtual int socketFd() const { return -1; }
+
+    /**
+     * @brief Sets how many unread bytes the peer may accumulate before send() fails.
+     */
+    void setSendLimit(size_t limit) { sendLimit = limit; }
+
+protected:
+    size_t sendLimit = kDefaultSendLimit; // Slow-consumer threshold in bytes
+};
+
+/**
+ * @brief A source of incoming connections.
+ */
+class Listener {
+public:
+    virtual ~Listener() = default;
+
+    /**
+     * @brief Accepts one pending connection.
+     * @return The connection, or nullptr if none was pending.
+     */
+    virtual std::unique_ptr<Connection> accept() = 0;
+
+    /**
+     * @brief A descriptor that polls readable while connections are pending.
+     */
+    virtual int pollFd() const = 0;
+
+    /**
+     * @brief Short transport name ("tcp", "unix", ...), for logging and hand-off.
+     */
+    virtual const char* kind() const = 0;
+};
+
+/**
+ * @brief Factory for listeners and connections of one endpoint kind.
+ */
+class Transport {
+public:
+    virtual ~Transport() = default;
+    virtual std::unique_ptr<Listener> listen(const std::string& address) = 0;
+    virtual std::unique_ptr<Connection> connect(const std::string& address) = 0;
+};
+
+/**
+ * @brief Wakes a thread waiting in recv() when another thread starts buffering output it must flush.
+ */
+class OutputWakeup {
+public:
+    OutputWakeup() : fd(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)) {}
+    OutputWakeup(const OutputWakeup&) = delete;
+    OutputWakeup& operator=(const OutputWakeup&) = delete;
+    ~OutputWakeup() {
+        if (fd >= 0) close(fd);
+    }
+
+    void notify() {
+        uint64_t one = 1;
+        ssize_t ignored = write(fd, &one, sizeof(one));
+        (void)ignored;
+    }
+
+    /**
+     * @brief Consumes the wake-ups so far.
+     */
+    void clear() {
+        uint64_t count;
+        ssize_t ignored = read(fd, &count, sizeof(count));
+        (void)ignored;
+    }
+
+    /**
+     * @brief Polls readable while a wake-up is pending.
+     */
+    int pollFd() const { return fd; }
+
+private:
+    int fd; // eventfd
+};
+
+/**
+ * @brief Half-closes a socket and discards its input until the peer closes too or the deadline passes.
+ *
+ * Closing a socket with unread input resets the connection (RST on TCP,
+ * ECONNRESET on seqpacket), and the reset throws away replies the peer has
+ * not read yet, such as the last "Burger Served" and "No more burgers" after
+ * pipelined orders. Sending our FIN first and waiting for the peer's lets
+ * them arrive.
+ */
+inline void lingerBeforeClose(int fd, std::chrono::steady_clock::time_point deadline) {
+    if (shutdown(fd, SHUT_WR) < 0) return;
+    char discard[4096];
+    while (true) {
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+        if (left.count() <= 0) return;
+        pollfd pfd{fd, POLLIN, 0};
+        if (poll(&pfd, 1, static_cast<int>(left.count())) <= 0) return;
+        ssize_t received = ::recv(fd, discard, sizeof(discard), MSG_DONTWAIT);
+        if (received == 0 || (received < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) return;
+    }
+}
+
+/**
+ * @brief A connection over a stream or seqpacket socket.
+ */
+class SocketConnection : public Connection {
+public:
+    SocketConnection(int fd, const char* kindName) : fd(fd), kindName(kindName) {}
+    ~SocketConnection() override {
+        if (fd >= 0) close(fd);
+    }
+
+    bool send(const char* message, size_t len) override {
+        std::lock_guard<std::mutex> lock(outboxMutex);
+        if (outbox.empty()) {
+            ssize_t sent = ::send(fd, message, len, MSG_NOSIGNAL | MSG_DONTWAIT);
+            if (sent == static_cast<ssize_t>(len)) return true;
+            if (sent < 0 && errno != EAGAIN && errno != EWOULDBLOCK) return false;
+            outboxOffset = sent > 0 ? static_cast<size_t>(sent) : 0;
+            outputQueued.notify(); // recv() may be waiting without POLLOUT
+        }
+        outbox.emplace_back(message, len);
+        outboxBytes += len;
+        return outboxBytes - outboxOffset <= sendLimit;
+    }
+
+    int recv(char* buffer, size_t capacity, int timeoutMs = -1) override {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+        while (true) {
+            bool pendingOutput = hasPendingOutput();
+            int waitMs = timeoutMs;
+            if (timeoutMs >= 0) {
+                auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+                waitMs = static_cast<int>(std::max<long>(0, left.count()));
+            }
+            pollfd pfds[2] = {{fd, static_cast<short>(POLLIN | (pendingOutput ? POLLOUT : 0)), 0},
+                              {outputQueued.pollFd(), POLLIN, 0}};
+            int ready = poll(pfds, 2, waitMs);
+            if (ready < 0) return -1;
+            if (ready == 0) {
+                if (timeoutMs >= 0) return kRecvTimedOut;
+                continue;
+            }
+            if (pfds[1].revents & POLLIN) outputQueued.clear(); // Poll again, now for POLLOUT too
+            if (pfds[0].revents & POLLOUT) {
+                if (!flushOutbox()) return -1;
+            }
+            if (!(pfds[0].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+            return static_cast<int>(::recv(fd, buffer, capacity, 0));
+        }
+    }
+
+    void flush(int timeoutMs) override {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+        while (hasPendingOutput() && std::chrono::steady_clock::now() < deadline) {
+            pollfd pfd{fd, POLLOUT, 0};
+            if (poll(&pfd, 1, 10) < 0 || !flushOutbox()) return;
+        }
+    }
+
+    void closeGracefully(int timeoutMs) override {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+        flush(timeoutMs);
+        if (!hasPendingOutput()) lingerBeforeClose(fd, deadline); // Unsent replies would be lost anyway
+    }
+
+    const char* kind() const override { return kindName; }
+    int socketFd() const override { return fd; }
+
+    /**
+     * @brief Gives up ownership of the socket.
+     */
+    int release() {
+        int released = fd;
+        fd = -1;
+        return released;
+    }
+
+private:
+    bool hasPendingOutput() {
+        std::lock_guard<std::mutex> lock(outboxMutex);
+        return !outbox.empty();
+    }
+
+    /**
+     * @brief Writes as much buffered output as the socket takes without blocking.
+     * @return false if the socket failed.
+     */
+    bool flushOutbox() {
+        std::lock_guard<std::mutex> lock(outboxMutex);
+        while (!outbox.empty()) {
+            const std::string& front = outbox.front();
+            ssize_t sent = ::send(fd, front.data() + outboxOffset, front.size() - outboxOffset, MSG_NOSIGNAL | MSG_DONTWAIT);
+            if (sent < 0) return errno == EAGAIN || errno == EWOULDBLOCK;
+            outboxOffset += sent;
+            if (outboxOffset < front.size()) return true;
+            outboxBytes -= front.size();
+            outboxOffset = 0;
+            outbox.pop_front();
+        }
+        return true;
+    }
+
+    int fd; // Connected socket
+    const char* kindName; // Transport name for logging
+    std::mutex outboxMutex; // Guards the output buffer
+    std::deque<std::string> outbox; // Messages the socket has not taken yet (whole, for seqpacket)
+    size_t outboxOffset = 0; // Bytes of the front message already sent
+    size_t outboxBytes = 0; // Total bytes of the messages in outbox
+    OutputWakeup outputQueued; // Signalled when outbox stops being empty
+};
+
+/**
+ * @brief A connection over a shared-memory ring channel.
+ *
+ * Owns the Unix socket the channel was negotiated on, which stays open so
+ * either side notices when the other goes away.
+ */
+class ShmConnection : public Connection {
+public:
+    ShmConnection(int controlSocket, std::unique_ptr<ShmEndpoint> endpoint, bool waitForRoom)
+        : control(controlSocket), endpoint(std::move(endpoint)), waitForRoom(waitForRoom) {}
+    ~ShmConnection() override {
+        endpoint.reset();
+        close(control);
+    }
+
+    /**
+     * @brief Upgrades an accepted Unix stream connection (server side).
+     *
+     * Called after the client sent "ShmRing"; creates the channel and passes its
+     * descriptors back with SCM_RIGHTS.
+     *
+     * @return The upgraded connection, or nullptr if the channel could not be set up.
+     */
+    static std::unique_ptr<Connection> upgrade(SocketConnection& socketConnection) {
+        std::unique_ptr<ShmEndpoint> endpoint(new ShmEndpoint());
+        if (!endpoint->create(socketConnection.socketFd()) || !endpoint->sendDescriptors(Message<ControlType::ShmRingAccepted>::text)) {
+            return nullptr;
+        }
+        return std::unique_ptr<Connection>(new ShmConnection(socketConnection.release(), std::move(endpoint), false));
+    }
+
+    /**
+     * @brief Publishes into the ring, which doubles as the bounded output buffer.
+     *
+     * The server side never waits: a full ring means a slow consumer. The client
+     * side waits for room since it only ever has a handful of orders in flight.
+     */
+    bool send(const char* message, size_t len) override {
+        std::lock_guard<std::mutex> lock(sendMutex); // The ring has a single producer
+        return endpoint->send(message, len, waitForRoom);
+    }
+
+    int recv(char* buffer, size_t capacity, int timeoutMs = -1) override {
+        int len = endpoint->recv(buffer, capacity, timeoutMs);
+        if (len == kShmRingCorrupt) return -1; // An error, so the caller disconnects the peer
+        return len < 0 ? kRecvTimedOut : len;
+    }
+
+    const char* kind() const override { return "shm"; }
+
+private:
+    int control; // Unix stream socket used for negotiation and liveness
+    std::unique_ptr<ShmEndpoint> endpoint; // Our side of the channel
+    bool waitForRoom; // Whether send() waits while the ring is full
+    std::mutex sendMutex; // Serializes senders onto the ring
+};
+
+/**
+ * @brief The shared state of an in-process loopback connection pair.
+ */
+struct LoopbackPipe {
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::deque<std::string> queues[2]; // Messages waiting for side 0 and side 1
+    size_t queuedBytes[2] = {0, 0}; // Bytes waiting for each side
+    bool closed[2] = {false, false}; // Whether each side has gone away
+};
+
+/**
+ * @brief One side of an in-process loopback connection.
+ */
+class LoopbackConnection : public Connection {
+public:
+    LoopbackConnection(std::shared_ptr<LoopbackPipe> pipe, int side) : pipe(std::move(pipe)), side(side) {}
+    ~LoopbackConnection() override {
+        std::lock_guard<std::mutex> lock(pipe->mtx);
+        pipe->closed[side] = true;
+        pipe->cv.notify_all();
+    }
+
+    /**
+     * @brief Creates a connected pair of loopback connections.
+     */
+    static std::pair<std::unique_ptr<Connection>, std::unique_ptr<Connection>> createPair() {
+        std::shared_ptr<LoopbackPipe> pipe = std::make_shared<LoopbackPipe>();
+        return {std::unique_ptr<Connection>(new LoopbackConnection(pipe, 0)),
+                std::unique_ptr<Connection>(new LoopbackConnection(pipe, 1))};
+    }
+
+    bool send(const char* message, size_t len) override {
+        std::lock_guard<std::mutex> lock(pipe->mtx);
+        if (pipe->closed[1 - side]) return false;
+        pipe->queues[1 - side].emplace_back(message, len);
+        pipe->queuedBytes[1 - side] += len;
+        pipe->cv.notify_all();
+        return pipe->queuedBytes[1 - side] <= sendLimit;
+    }
+
+    int recv(char* buffer, size_t capacity, int timeoutMs = -1) override {
+        std::unique_lock<std::mutex> lock(pipe->mtx);
+        auto ready = [&] { return !pipe->queues[side].empty() || pipe->closed[1 - side]; };
+        if (timeoutMs < 0) {
+            pipe->cv.wait(lock, ready);
+        } else if (!pipe->cv.wait_for(lock, std::chrono::milliseconds(timeoutMs), ready)) {
+            return kRecvTimedOut;
+        }
+        if (pipe->queues[side].empty()) return 0; // Peer closed and everything was drained
+        std::string& message = pipe->queues[side].front();
+        size_t len = std::min(capacity, message.size());
+        memcpy(buffer, message.data(), len);
+        pipe->queuedBytes[side] -= message.size();
+        pipe->queues[side].pop_front();
+        return static_cast<int>(len);
+    }
+
+    const char* kind() const override { return "loopback"; }
+
+private:
+    std::shared_ptr<LoopbackPipe> pipe; // Shared queues
+    int side; // Which end of the pipe this is
+};
+
+/**
+ * @brief A listener for stream and seqpacket sockets.
+ */
+class SocketListener : public Listener {
+public:
+    SocketListener(int fd, const char* kindName, bool noDelay) : fd(fd), kindName(kindName), noDelay(noDelay) {}
+    ~SocketListener() override { close(fd); }
+
+    std::unique_ptr<Connection> accept() override {
+        int clientSocket = ::accept(fd, nullptr, nullptr);
+        if (clientSocket < 0) return nullptr;
+        if (noDelay) {
+            int on = 1; // Replies are tiny; never hold them back for coalescing
+            setsockopt(clientSocket, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+        }
+        return std::unique_ptr<Connection>(new SocketConnection(clientSocket, kindName));
+    }
+
+    int pollFd() const override { return fd; }
+    const char* kind() const override { return kindName; }
+
+private:
+    int fd; // Listening socket
+    const char* kindName; // Transport name for accepted connections
+    bool noDelay; // Whether accepted connections get TCP_NODELAY
+};
+
+/**
+ * @brief A listener for in-process loopback connections.
+ *
+ * Listeners register under a name; connecting to that name queues the server side
+ * of a new pair and signals an eventfd so the listener can be polled like a socket.
+ */
+class LoopbackListener : public Listener {
+public:
+    explicit LoopbackListener(const std::string& name) : name(name), event(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)) {
+        std::lock_guard<std::mutex> lock(registryMutex());
+        registry()[name] = this;
+    }
+    ~LoopbackListener() override {
+        {
+            std::lock_guard<std::mutex> lock(registryMutex());
+            registry().erase(name);
+        }
+        close(event);
+    }
+
+    /**
+     * @brief Connects to the listener registered under name.
+     * @return The client side of the new pair, or nullptr if nobody listens there.
+     */
+    static std::unique_ptr<Connection> connect(const std::string& name) {
+        std::lock_guard<std::mutex> lock(registryMutex());
+        auto it = registry().find(name);
+        if (it == registry().end()) return nullptr;
+        auto pair = LoopbackConnection::createPair();
+        std::lock_guard<std::mutex> pendingLock(it->second->pendingMutex);
+        it->second->pending.push_back(std::move(pair.second));
+        uint64_t one = 1;
+        ssize_t ignored = write(it->second->event, &one, sizeof(one)); // Under the lock so accept() never misses it
+        (void)ignored;
+        return std::move(pair.first);
+    }
+
+    std::unique_ptr<Connection> accept() override {
+        std::lock_guard<std::mutex> lock(pendingMutex);
+        if (pending.empty()) {
+            uint64_t count;
+            ssize_t ignored = read(event, &count, sizeof(count)); // Re-arm the eventfd
+            (void)ignored;
+            return nullptr;
+        }
+        std::unique_ptr<Connection> connection = std::move(pending.front());
+        pending.pop_front();
+        if (pending.empty()) {
+            uint64_t count;
+            ssize_t ignored = read(event, &count, sizeof(count));
+            (void)ignored;
+        }
+        return connection;
+    }
+
+    int pollFd() const override { return event; }
+    const char* kind() const override { return "loopback"; }
+
+private:
+    static std::mutex& registryMutex() {
+        static std::mutex mtx;
+        return mtx;
+    }
+    static std::map<std::string, LoopbackListener*>& registry() {
+        static std::map<std::string, LoopbackListener*> listeners;
+        return listeners;
+    }
+
+    std::string name; // Registered name
+    int event; // Readable while connections are pending
+    std::mutex pendingMutex;
+    std::deque<std::unique_ptr<Connection>> pending; // Server sides waiting to be accepted
+};
+
+/**
+ * @brief TCP transport. Addresses are "<ip>:<port>"; listeners bind all interfaces.
+ *
+ * With reusePort, several processes may each listen on the same port and the
+ * kernel spreads incoming connections across them (SO_REUSEPORT).
+ */
+class TcpTransport : public Transport {
+public:
+    explicit TcpTransport(bool reusePort = false) : reusePort(reusePort) {}
+
+    std::unique_ptr<Listener> listen(const std::string& address) override {
+        sockaddr_in addr{};
+        if (!parse(address, addr)) return nullptr;
+        addr.sin_addr.s_addr = INADDR_ANY;
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd < 0) return nullptr;
+        int reuse = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        if (reusePort) setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &reuse, sizeof(reuse));
+        if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || ::listen(fd, SOMAXCONN) < 0) {
+            close(fd);
+            return nullptr;
+        }
+        return std::unique_ptr<Listener>(new SocketListener(fd, "tcp", true));
+    }
+
+    std::unique_ptr<Connection> connect(const std::string& address) override {
+        sockaddr_in addr{};
+        if (!parse(address, addr)) return nullptr;
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd < 0) return nullptr;
+        if (::connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+            close(fd);
+            return nullptr;
+        }
+        return std::unique_ptr<Connection>(new SocketConnection(fd, "tcp"));
+    }
+
+private:
+    static bool parse(const std::string& address, sockaddr_in& addr) {
+        size_t colon = address.rfind(':');
+        if (colon == std::string::npos) return false;
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(atoi(address.c_str() + colon + 1));
+        std::string host = address.substr(0, colon);
+        return host.empty() || inet_pton(AF_INET, host.c_str(), &addr.sin_addr) > 0;
+    }
+
+    bool reusePort; // Whether listeners share their port with other processes
+};
+
+/**
+ * @brief Unix domain socket transport (stream or seqpacket). Addresses are paths.
+ */
+class UnixTransport : public Transport {
+public:
+    /**
+     * @param replaceLive Whether listen() may take a path over from a server still
+     *        listening on it, as a successor does in a hot upgrade.
+     */
+    UnixTransport(int type, const char* kindName, bool replaceLive = false) : type(type), kindName(kindName), replaceLive(replaceLive) {}
+
+    std::unique_ptr<Listener> listen(const std::string& address) override {
+        sockaddr_un addr{};
+        if (!parse(address, addr)) return nullptr;
+        if (replaceLive) {
+            unlink(address.c_str());
+        } else if (!removeStaleSocket(addr)) {
+            errno = EADDRINUSE;
+            return nullptr;
+        }
+        int fd = socket(AF_UNIX, type, 0);
+        if (fd < 0) return nullptr;
+        if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || ::listen(fd, SOMAXCONN) < 0) {
+            close(fd);
+            return nullptr;
+        }
+        return std::unique_ptr<Listener>(new SocketListener(fd, kindName, false));
+    }
+
+    std::unique_ptr<Connection> connect(const std::string& address) override {
+        sockaddr_un addr{};
+        if (!parse(address, addr)) return nullptr;
+        int fd = socket(AF_UNIX, type, 0);
+        if (fd < 0) return nullptr;
+        if (::connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+            close(fd);
+            return nullptr;
+        }
+        return std::unique_ptr<Connection>(new SocketConnection(fd, kindName));
+    }
+
+private:
+    static bool parse(const std::string& address, sockaddr_un& addr) {
+        if (address.size() >= sizeof(addr.sun_path)) return false;
+        addr.sun_family = AF_UNIX;
+        strncpy(addr.sun_path, address.c_str(), sizeof(addr.sun_path) - 1);
+        return true;
+    }
+
+    /**
+     * @brief Removes the socket file at addr if nobody listens on it any more.
+     *
+     * The probe connects without blocking and sends nothing, so a live server with
+     * a full backlog cannot stall it; the server sees a client that leaves at once.
+     * @return false if a server is listening there.
+     */
+    bool removeStaleSocket(const sockaddr_un& addr) const {
+        int probe = socket(AF_UNIX, type | SOCK_NONBLOCK, 0);
+        if (probe < 0) return true; // Let bind() report the problem
+        int connected = ::connect(probe, (const struct sockaddr*)&addr, sizeof(addr));
+        int error = errno;
+        close(probe);
+        if (connected == 0 || error == EAGAIN || error == EINPROGRESS) return false; // Listening, if too busy to queue us
+        if (error == ECONNREFUSED) unlink(addr.sun_path); // Left behind by a server that exited
+        return true;
+    }
+
+    int type; // SOCK_STREAM or SOCK_SEQPACKET
+    const char* kindName; // Transport name for logging
+    bool replaceLive; // Whether listen() may unlink a path a live server listens on
+};
+
+/**
+ * @brief Shared-memory ring transport, negotiated over a Unix stream socket.
+ *
+ * The server side listens on a plain Unix stream socket and upgrades connections
+ * that ask for it (see ShmConnection::upgrade).
+ */
+class ShmTransport : public Transport {
+public:
+    std::unique_ptr<Listener> listen(const std::string& address) override {
+        return UnixTransport(SOCK_STREAM, "unix").listen(address);
+    }
+
+    std::unique_ptr<Connection> connect(const std::string& address) override {
+        std::unique_ptr<Connection> control = UnixTransport(SOCK_STREAM, "unix").connect(address);
+        if (!control) return nullptr;
+        if (!Message<MessageType::ShmRing>::send(*control)) return nullptr;
+
+        char buffer[64] = {0};
+        int fds[kMaxPassedFds];
+        int fdCount = 0;
+        pollfd answer{control->socketFd(), POLLIN, 0};
+        if (poll(&answer, 1, kShmHandshakeTimeoutMs) <= 0) return nullptr; // A server that does not speak the handshake
+        int bytesReceived = ShmEndpoint::recvWithFds(control->socketFd(), buffer, sizeof(buffer) - 1, fds, fdCount);
+        if (bytesReceived <= 0 || !Message<ControlType::ShmRingAccepted>::prefixOf(buffer, bytesReceived) || fdCount != kShmFdCount) {
+            for (int i = 0; i < fdCount; ++i) close(fds[i]);
+            return nullptr;
+        }
+
+        int controlSocket = static_cast<SocketConnection&>(*control).release();
+        std::unique_ptr<ShmEndpoint> endpoint(new ShmEndpoint());
+        if (!endpoint->attach(controlSocket, fds)) {
+            close(controlSocket);
+            return nullptr;
+        }
+        return std::unique_ptr<Connection>(new ShmConnection(controlSocket, std::move(endpoint), true));
+    }
+};
+
+/**
+ * @brief In-process loopback transport. Addresses are arbitrary names.
+ */
+class LoopbackTransport : public Transport {
+public:
+    std::unique_ptr<Listener> listen(const std::string& address) override {
+        return std::unique_ptr<Listener>(new LoopbackListener(address));
+    }
+
+    std::unique_ptr<Connection> connect(const std::string& address) override {
+        return LoopbackListener::connect(address);
+    }
+};
+
+/**
+ * @brief Returns the transport for an endpoint and strips its scheme.
+ *
+ * Endpoints without a known scheme are treated as TCP.
+ *
+ * @param endpoint "<scheme>:<address>"; replaced by the bare address.
+ * @return The transport, never nullptr.
+ */
+inline std::unique_ptr<Transport> transportFor(std::string& endpoint) {
+    size_t colon = endpoint.find(':');
+    std::string scheme = colon == std::string::npos ? "" : endpoint.substr(0, colon);
+    std::unique_ptr<Transport> transport;
+    if (scheme == "unix") {
+        transport.reset(new UnixTransport(SOCK_STREAM, "unix"));
+    } else if (scheme == "seqpacket") {
+        transport.reset(new UnixTransport(SOCK_SEQPACKET, "seqpacket"));
+    } else if (scheme == "shm") {
+        transport.reset(new ShmTransport());
+    } else if (scheme == "loopback") {
+        transport.reset(new LoopbackTransport());
+    } else {
+        if (scheme == "tcp") endpoint.erase(0, colon + 1);
+        return std::unique_ptr<Transport>(new TcpTransport());
+    }
+    endpoint.erase(0, colon + 1);
+    return transport;
+}
+
+#endif // BURGER_TRANSPORT_H